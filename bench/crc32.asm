@@ -0,0 +1,71 @@
+; Bitwise CRC-32 (polynomial $EDB88320) of 4 KiB at $4000, filled with (3 + 7*i) & $FF
+; Leaves the CRC, $5E4E1995, little-endian in $10-$13
+buf = $4000
+ptr = $00
+crc = $10
+
+start:  LDA #<buf
+        STA ptr
+        LDA #>buf
+        STA ptr+1
+        LDX #$10
+        LDY #0
+        LDA #3
+fill:   STA (ptr),Y
+        CLC
+        ADC #7
+        INY
+        BNE fill
+        INC ptr+1
+        DEX
+        BNE fill
+
+        LDA #$FF
+        STA crc
+        STA crc+1
+        STA crc+2
+        STA crc+3
+        LDA #>buf
+        STA ptr+1
+        LDX #$10
+        LDY #0
+byte:   LDA (ptr),Y
+        EOR crc
+        STA crc
+        TXA
+        PHA
+        LDX #8
+bit:    LSR crc+3       ; Shift right one bit, xoring in the polynomial if a 1 fell out
+        ROR crc+2
+        ROR crc+1
+        ROR crc
+        BCC nopoly
+        LDA crc+3
+        EOR #$ED
+        STA crc+3
+        LDA crc+2
+        EOR #$B8
+        STA crc+2
+        LDA crc+1
+        EOR #$83
+        STA crc+1
+        LDA crc
+        EOR #$20
+        STA crc
+nopoly: DEX
+        BNE bit
+        PLA
+        TAX
+        INY
+        BNE byte
+        INC ptr+1
+        DEX
+        BNE byte
+
+        LDX #3
+final:  LDA crc,X
+        EOR #$FF
+        STA crc,X
+        DEX
+        BPL final
+        BRK
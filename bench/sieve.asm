@@ -0,0 +1,65 @@
+; Sieve of Eratosthenes over 2..8191
+; Leaves the number of primes found, 1028 ($0404), in $10-$11
+flags = $2000           ; One byte per number, $2000-$3FFF, non-zero while it may be prime
+ptr = $00
+mptr = $02
+n = $04
+count = $10
+
+start:  LDA #<flags     ; Mark every number as possibly prime
+        STA ptr
+        LDA #>flags
+        STA ptr+1
+        LDX #$20
+        LDY #0
+        LDA #1
+fill:   STA (ptr),Y
+        INY
+        BNE fill
+        INC ptr+1
+        DEX
+        BNE fill
+
+        LDA #0
+        STA count
+        STA count+1
+        LDA #2
+        STA n
+        LDA #0
+        STA n+1
+loop:   CLC             ; ptr = flags + n
+        LDA n
+        ADC #<flags
+        STA ptr
+        LDA n+1
+        ADC #>flags
+        STA ptr+1
+        LDY #0
+        LDA (ptr),Y
+        BEQ next
+        INC count       ; n is prime
+        BNE strike
+        INC count+1
+strike: LDA ptr         ; Clear every multiple of n above it
+        STA mptr
+        LDA ptr+1
+        STA mptr+1
+mark:   CLC
+        LDA mptr
+        ADC n
+        STA mptr
+        LDA mptr+1
+        ADC n+1
+        STA mptr+1
+        CMP #$40
+        BCS next
+        LDA #0
+        STA (mptr),Y
+        JMP mark
+next:   INC n
+        BNE check
+        INC n+1
+check:  LDA n+1
+        CMP #$20
+        BNE loop
+        BRK
@@ -0,0 +1,31 @@
+; Bubble sort of 256 bytes at $0300, starting from descending order, the worst case
+; Leaves $0300-$03FF holding 0..255 in order
+data = $0300
+swapped = $10
+
+start:  LDX #0
+init:   TXA
+        EOR #$FF
+        STA data,X
+        INX
+        BNE init
+
+pass:   LDA #0
+        STA swapped
+        LDX #0
+inner:  LDA data,X
+        CMP data+1,X
+        BCC ordered
+        BEQ ordered
+        LDY data+1,X    ; Swap the pair
+        STA data+1,X
+        TYA
+        STA data,X
+        LDA #1
+        STA swapped
+ordered: INX
+        CPX #$FF
+        BNE inner
+        LDA swapped
+        BNE pass
+        BRK
@@ -0,0 +1,26 @@
+#ifndef ARITHMETIC_H
+#define ARITHMETIC_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Precomputed results of ADC and SBC for every accumulator, operand, carry and decimal flag
+// Each entry holds the new accumulator in its low byte, and the N, V, Z and C flags
+// in its high byte, at their positions in P
+//
+// Decimal mode follows the NMOS 6502, including for operands that are not valid BCD:
+// the result and carry come from the decimal adjustment of each nibble,
+// Z always comes from the binary result, and N and V from the intermediate result
+// for ADC, or from the binary result for SBC
+class Arithmetic {
+ public:
+    static constexpr size_t index(uint8_t a, uint8_t operand, uint8_t p) {
+        return (p & 0x08) << 14 | (p & 0x01) << 16 | a << 8 | operand;
+    }
+
+    static const std::array<uint16_t, 0x40000> adc_table;
+    static const std::array<uint16_t, 0x40000> sbc_table;
+};
+
+#endif // ARITHMETIC_H
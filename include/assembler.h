@@ -0,0 +1,89 @@
+#ifndef ASSEMBLER_H
+#define ASSEMBLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "instruction.h"
+#include "loader.h"
+#include "memory.h"
+
+// Two-pass assembler over the Instructions table, for the syntax of the programs in bench/
+//
+//   buf = $4000              ; Constants, defined before they are used
+//   start:  LDA #<buf        ; Labels end with a colon, comments start with a semicolon
+//           STA (ptr),Y
+//           .org $FFFC       ; Starts a new segment
+//           .word start, 0
+//           .byte 1, "text", >buf
+//
+// Numbers are decimal, $hex, %binary or 'c'
+// Expressions combine them with symbols and * (the address of the current line) using + - * / & | ^,
+// with the usual precedence, unary -, and < and > for the low and high byte
+// There are no parentheses in expressions, which would be mistaken for indirect addressing
+// Operands are zero page when their value is known in the first pass and fits in a byte,
+// so symbols used before they are defined always get absolute addressing where it exists
+// Mnemonics, directives and index registers are case-insensitive, symbols are not
+//
+// An Assembler keeps its buffers from one program to the next, so reusing one to assemble many
+// programs costs little more than parsing them
+// Throws std::runtime_error, naming the line, for malformed source, undefined or duplicate symbols
+// and operands out of range, and std::invalid_argument for programs that do not fit in 64 KiB
+class Assembler {
+ public:
+    // Where the program starts when it has no .org before its first line of code
+    Assembler(uint16_t origin=0x600) : origin(origin) {};
+
+    // The image owns its bytes, and its entry is the start of the first segment
+    ProgramImage assemble(std::string_view source);
+
+    // Writes the program into mem like ProgramImage::load_into, returning its entry
+    uint16_t assemble(std::string_view source, Memory &mem);
+
+    // Writes the program into buffer, which holds the addresses from base onwards, returning its entry
+    // Bytes the program does not cover are left alone
+    uint16_t assemble(std::string_view source, uint8_t *buffer, size_t size, uint16_t base=0);
+
+    // Value of a label or constant in the last program assembled
+    std::optional<uint16_t> symbol(std::string_view name) const;
+
+ private:
+    enum class Kind : uint8_t { INSTRUCTION, BYTE, WORD };
+
+    // A line that emits bytes, decoded in the first pass and emitted in the second
+    typedef struct Statement {
+        Kind kind;
+        uint8_t opcode;
+        uint16_t address;
+        uint32_t line;
+        std::string_view operand; // Expression alone for instructions, without # or addressing syntax
+    } Statement;
+
+    typedef struct Block {
+        uint16_t address;
+        size_t size;
+    } Block;
+
+    uint16_t origin;
+
+    // All of these are kept for reuse, symbols and statements point into text
+    std::string text;
+    std::unordered_map<std::string_view, int32_t> symbols;
+    std::vector<Statement> statements;
+    std::vector<Block> blocks;
+    std::vector<uint8_t> bytes;
+    ProgramImage program; // Points into bytes
+
+    // Runs both passes, leaving the result in program
+    void run(std::string_view source);
+    void first_pass();
+    void second_pass();
+    void parse_line(std::string_view line, uint32_t number, uint32_t &pc);
+};
+
+#endif // ASSEMBLER_H
@@ -0,0 +1,67 @@
+#ifndef BATCH_RUNNER_H
+#define BATCH_RUNNER_H
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "cpu_6502.h"
+#include "ram.h"
+#include "thread_pool.h"
+
+// Range of addresses [start, start+length)
+typedef struct MemoryRange {
+    uint16_t start;
+    uint32_t length;
+} MemoryRange;
+
+// An independent program run, from a fresh 64 KiB of zeroed RAM
+typedef struct BatchJob {
+    std::shared_ptr<const std::vector<uint8_t>> image; // Can be shared by jobs running the same program
+    uint16_t load_address = 0;
+    uint16_t reset_vector = 0;
+    uint64_t cycle_limit = 0; // 0 for the runner's default
+
+    // Exit conditions, besides running out of cycles or halting
+    bool stop_on_brk = true;
+    std::optional<uint16_t> stop_pc;
+
+    std::vector<MemoryRange> capture; // Memory collected into the result
+} BatchJob;
+
+typedef struct BatchResult {
+    StopReason reason;
+    uint64_t cycles;
+    Registers registers;
+    std::vector<uint8_t> memory; // The captured ranges, concatenated in order
+} BatchResult;
+
+// Runs many independent jobs across a work-stealing thread pool
+// Each worker reuses a single machine for all the jobs it runs,
+// so only one 64 KiB RAM per worker is resident however many jobs there are
+class BatchRunner {
+ public:
+    explicit BatchRunner(size_t threads=std::thread::hardware_concurrency());
+
+    // Results are in the same order as jobs
+    // Throws std::invalid_argument if an image or capture range does not fit in memory
+    std::vector<BatchResult> run(const std::vector<BatchJob> &jobs);
+
+    size_t threads() const { return pool.size(); }
+
+    // Cycle limit for jobs that leave theirs at 0
+    void set_default_cycle_limit(uint64_t cycles) { default_cycle_limit = cycles; }
+
+ private:
+    ThreadPool pool;
+    uint64_t default_cycle_limit = 100000000;
+    std::vector<std::shared_ptr<RAM<0x10000>>> machines; // One per worker
+
+    static void validate(const BatchJob &job);
+    static void run_job(const BatchJob &job, uint64_t cycle_limit, const std::shared_ptr<RAM<0x10000>> &mem,
+                        BatchResult &result);
+    static void capture(const std::shared_ptr<RAM<0x10000>> &mem, const MemoryRange &range, std::vector<uint8_t> &out);
+};
+
+#endif // BATCH_RUNNER_H
@@ -1,14 +1,31 @@
 #ifndef CPU_6502
 #define CPU_6502
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <functional>
+#include <limits>
 #include <memory>
-#include <map>
-#include <string>
+#include <optional>
 #include <stdexcept>
+#include <vector>
 
+#include <type_traits>
+#include <utility>
+
+#include "arithmetic.h"
+#include "debugger.h"
+#include "event_scheduler.h"
 #include "instruction.h"
+#ifdef CPU6502_JIT
+#include "jit_x64.h"
+#endif
 #include "memory.h"
+#include "paged_memory.h"
+#include "profiler.h"
+#include "ram.h"
+#include "trace.h"
 
 // Flag masks from github.com/gianlucag/mos6502
 // Single-bit masks (e.g. 0x40 = 01000000)
@@ -25,107 +42,435 @@
 #define RST_VEC 0xFFFC
 #define IRQ_VEC 0xFFFE
 
+// Why a batched run returned control to the caller
+enum class StopReason {
+    BUDGET,     // The cycle or instruction budget was used up
+    BRK,        // A BRK was fetched while stop_on_brk is set
+    BREAKPOINT, // The stop predicate returned true, or a debugger breakpoint was reached
+    WATCHPOINT, // The last instruction accessed an address watched by the debugger
+    HALT        // The CPU is jammed on an illegal opcode
+};
+
+// Programmer-visible registers
+typedef struct Registers {
+    uint8_t A, X, Y, P, S;
+    uint16_t PC;
+} Registers;
+
+// Everything needed to resume execution exactly where it left off,
+// including the unfinished cycles of the current instruction
+typedef struct CPUState {
+    Registers registers;
+    int cycles_left;
+    uint64_t total_cycles;
+    bool halted;
+    bool irq_line;
+} CPUState;
+
+typedef struct RunResult {
+    uint64_t cycles; // Cycles actually consumed by this run
+    StopReason reason;
+} RunResult;
+
+// Bus is the memory the CPU is wired to, and only needs to provide
+// uint8_t read_byte(uint16_t) and void write_byte(uint16_t, uint8_t)
+// With a concrete Bus these calls are resolved at compile time, and can be inlined
+// With an abstract one, such as Memory, the CPU also uses its page_table()
+// to bypass the virtual calls for plain memory pages
+//
+// The library ships CPU6502<Memory>, CPU6502<RAM<0x10000>> and CPU6502<PagedMemory>
+// Other buses need to include cpu_6502_impl.h
+template <class Bus=Memory>
 class CPU6502 {
  public:
-    CPU6502(std::shared_ptr<Memory> mem);
+    CPU6502(std::shared_ptr<Bus> mem);
 
+    // Advances by a single cycle
     void step();
     void reset();
     void nmi();
+    // Takes an IRQ right away, unless I is set, in which case it is lost
     void irq();
 
+    // Holds the IRQ line asserted or releases it, as a device driving the 6502's /IRQ pin would
+    // While asserted, an IRQ is taken at every instruction boundary where I is clear,
+    // so an interrupt raised while I is set waits for CLI, PLP or RTI instead of being lost
+    // Devices release the line once the handler acknowledges them, and ones that share it combine their requests
+    void set_irq_line(bool asserted) { irq_line = asserted; }
+
+    // Run until the cycle budget is used up or execution stops
+    // An instruction that straddles the end of the budget is still executed,
+    // and its remaining cycles are consumed at the start of the next run
+    RunResult run_cycles(uint64_t budget);
+
+    // Run for a number of instructions, including all cycles of the last one
+    RunResult run_instructions(uint64_t count);
+
+    // Run until pred() returns true at an instruction boundary
+    template <class Pred>
+    RunResult run_until(Pred pred, uint64_t budget=std::numeric_limits<uint64_t>::max()) {
+        return run(budget, std::numeric_limits<uint64_t>::max(), pred);
+    }
+
+    // When set, batched runs stop before executing a BRK instead of taking the interrupt
+    void set_stop_on_brk(bool stop) { stop_on_brk = stop; }
+
+    // Stops a run with StopReason::BREAKPOINT before the instruction at addr, once, and then clears it
+    // Unlike a run_until() predicate or a debugger breakpoint, this keeps the block cache and the JIT running
+    void set_stop_pc(std::optional<uint16_t> addr);
+
+    // Stops the current run with StopReason::BREAKPOINT once the instruction being executed completes,
+    // for I/O handlers and event callbacks, which run on the CPU's thread
+    void request_stop() { stop_requested = true; }
+
+    // Records executed instructions into buffer, at the given level
+    // Has no effect unless the library is compiled with CPU6502_TRACE
+    void set_trace(std::shared_ptr<TraceBuffer> buffer, TraceLevel level=TraceLevel::ALL);
+
+    // Counts executed instructions per PC and per opcode into profiler, and follows calls
+    // Profiled code runs through the interpreter alone, without the block cache or the JIT,
+    // and tracing takes precedence when both are enabled
+    // Has no effect unless the library is compiled with CPU6502_PROFILE
+    void set_profiler(std::shared_ptr<Profiler> profiler) { this->profiler = profiler; }
+
+    // Stops batched runs at the debugger's breakpoints and watchpoints, see Debugger
+    // Code runs without the JIT while a debugger is attached
+    void set_debugger(std::shared_ptr<Debugger> debugger) { this->debugger = debugger; }
+
+    // Runs events as soon as get_cycles() reaches their due cycle, at the next instruction boundary
+    // Batched runs carry on through events rather than returning for them,
+    // and translated code is never given a budget that reaches past the next one
+    // Callbacks may call nmi() and irq(), whose sequences then run before the next instruction,
+    // or set_irq_line() for an IRQ that waits until I is clear
+    void set_events(std::shared_ptr<EventScheduler> events) { this->events = events; }
+
+    // When enabled, straight-line runs of code are decoded once into blocks,
+    // which are then executed without fetching and decoding each instruction again
+    // run_cycles() and run_instructions() run blocks back to back, only looking for events between blocks,
+    // while no debugger, trace or profiler is attached;
+    // run_until() and step(), which stop between any two instructions, do not use the cache
+    // Stores made by the CPU drop the blocks of the page they hit, but memory changed
+    // any other way (by another thread, load_file, PagedMemory::restore...) must be reported
+    void set_block_cache(bool enabled);
+    void invalidate_code(uint16_t start=0x0000, uint32_t length=0x10000);
+
+    // When enabled, run_cycles() executes hot code translated to x86-64, see JitX64
+    // With the block cache on as well, translated code is tried first at the end of every block
+    // The same rules as for the block cache apply to memory changed behind the CPU's back
+    // Has no effect unless the library is compiled with CPU6502_JIT
+    void set_jit(bool enabled);
+
+    // Cycles elapsed since construction, including those of interrupt sequences
+    uint64_t get_cycles() const { return total_cycles - cycles_left; }
+
+    bool is_halted() const { return halted; }
+    uint16_t get_pc() const { return PC; }
+    Registers get_registers() const { return { A, X, Y, status(), S, PC }; }
+
+    // Together with PagedMemory::snapshot(), these fork a whole machine:
+    // a new CPU on a PagedMemory built from the memory snapshot, loaded with the saved state
+    CPUState save_state() const;
+    void load_state(const CPUState &state);
+
  private:
-    std::shared_ptr<Memory> mem;
+    std::shared_ptr<Bus> mem;
+
+    // Direct pointers for plain memory pages, from mem->page_table()
+    // Pages without one are accessed through their io entry, or the Memory interface
+    // Only used for accesses when Bus is abstract, otherwise only to keep I/O pages out of the block cache
+    const PageTable *pages;
+    static const PageTable no_pages;
 
     /*
      * 8-bit registers
      * A: Accumulator
      * X, Y: Index registers
-     * P: Flag bits (NV-BDIZC)
+     * P: Flag bits (NV-BDIZC), except for N and Z, which are always clear in P itself
      * S: Stack pointer
      */
     uint8_t A, X, Y, P, S;
 
+    // N and Z are evaluated lazily from the last result that set them,
+    // since most are overwritten before a branch, PHP or interrupt reads them
+    // N is bit 7 of n_result, and Z is set when z_result is zero
+    // They only differ after BIT, PLP and RTI, and decimal mode ADC
+    uint8_t n_result, z_result;
+
     // 16-bit program counter
     uint16_t PC;
-    uint16_t offset;
 
     // Number of cycles remaining for current instruction
     int cycles_left;
 
-    // Addressing modes return a reference to the appropriate data
-    // Note that all of them return actual data, IMM returns the uint16_t at PC+1
-    uint8_t &Addr_ACC(); // Accumulator
-    uint8_t &Addr_IMM(); // Immediate
-    uint8_t &Addr_ABS(); // Absolute
-    uint8_t &Addr_ZER(); // Zero page
-    uint8_t &Addr_ZEX(); // Zero page, X-indexed
-    uint8_t &Addr_ZEY(); // Zero page, Y-indexed
-    uint8_t &Addr_ABX(); // Absolute, X-indexed
-    uint8_t &Addr_ABY(); // Absolute, Y-indexed
-    uint8_t &Addr_IMP(); // Implied
-    uint8_t &Addr_REL(); // Relative
-    uint8_t &Addr_INX(); // Indirect, X-indexed
-    uint8_t &Addr_INY(); // Indirect, Y-indexed
-    uint8_t &Addr_ABI(); // Absolute indirect
-
-    // Maps between the names of intructions and modes to their implementations
-    std::map<std::string, std::function<void(uint8_t&)>> instr_funcs;
-    std::map<std::string, std::function<uint8_t&(void)>> mode_funcs;
+    // Cycles of every instruction started since construction
+    uint64_t total_cycles = 0;
+
+    // Cycles added to the current instruction's base count by page crossings and taken branches
+    int extra_cycles;
+    bool page_crossed = false;
+
+    // Set when an illegal opcode jams the CPU, until the next reset
+    bool halted;
+    bool stop_on_brk = false;
+
+    // set_stop_pc's address, or one no PC can match
+    static const uint32_t no_stop_pc = 0x10000;
+    uint32_t stop_pc = no_stop_pc;
+    bool stop_requested = false;
+
+    // Sampled between instructions; blocks and translated code, which may clear I along the way,
+    // are not entered while it is held
+    bool irq_line = false;
+
+    std::shared_ptr<TraceBuffer> trace;
+    TraceLevel trace_level = TraceLevel::OFF;
+
+    std::shared_ptr<Profiler> profiler;
+    std::shared_ptr<Debugger> debugger;
+    std::shared_ptr<EventScheduler> events;
+
+    // Runs the events due by now, at an instruction boundary
+    // Returns whether they started an interrupt sequence, which then has to run before the next instruction
+    inline bool run_events() {
+        if (!events || total_cycles < events->next_due()) return false;
+        events->run_due(total_cycles);
+        return cycles_left != 0;
+    }
+
+    // Takes an IRQ if the line is held and I is clear, at an instruction boundary
+    inline bool sample_irq() {
+        if (!irq_line || (P & INTERRUPT)) return false;
+        irq();
+        return true;
+    }
+
+    // Fetches, decodes and executes the instruction at PC
+    void execute_instruction();
+    void execute_traced(uint8_t opcode);
+    void execute_profiled(uint8_t opcode);
+    // Runs cached blocks from PC, one after the other, until an event is due, one cannot be cached,
+    // or slice or instructions would be used up
+    // The cycles consumed are added to used, leaving any of the last instruction's in cycles_left
+    // False, having run nothing, if the instruction at PC cannot be cached
+    // native hands back to run() at every block exit instead, for translated code to take over
+    bool execute_block(uint64_t slice, uint64_t &used, uint64_t &instructions, bool native);
+    bool batch_blocks() const;
+
+    void add_cycles(int cycles);
+
+    // native allows translated code to run, which never stops between instructions for pred
+    // Runs given a NoStop never ask for it, so the block cache can run whole blocks in one go
+    typedef struct NoStop {
+        bool operator()() const { return false; }
+    } NoStop;
+    template <class Pred>
+    RunResult run(uint64_t budget, uint64_t instructions, Pred &pred, bool native=false);
+
+    // Runs a translated block at PC if there is one, and its worst case fits in budget
+    bool execute_native(uint64_t budget);
+
+    // Accesses to pages without a direct pointer when Bus is abstract,
+    // which only reach the Memory interface for I/O addresses and pages without any pointer
+    uint8_t fetch_slow(uint16_t addr);
+    void write_slow(uint16_t addr, uint8_t data);
+
+    // Instruction fetches, which watchpoints do not see
+    inline uint8_t fetch(uint16_t addr) {
+        if constexpr (std::is_abstract<Bus>::value) {
+            const uint8_t *page = pages->read[addr >> 8];
+            return page ? page[addr & 0xFF] : fetch_slow(addr);
+        }
+        else {
+            return mem->Bus::read_byte(addr);
+        }
+    }
+
+    // All data accesses made by instructions go through these
+    inline uint8_t read(uint16_t addr) {
+        uint8_t data = fetch(addr);
+        if (debugger) debugger->on_read(addr, data);
+        return data;
+    }
+
+    inline void write(uint16_t addr, uint8_t data) {
+        if (debugger) debugger->on_write(addr, data);
+        if (code_map && code_map[addr]) invalidate_page(addr >> 8);
+        if constexpr (std::is_abstract<Bus>::value) {
+            uint8_t *page = pages->write[addr >> 8];
+            if (page) page[addr & 0xFF] = data;
+            else write_slow(addr, data);
+        }
+        else {
+            mem->Bus::write_byte(addr, data);
+        }
+    }
+
+    // Interrupt and reset vectors are fetched like instructions, out of sight of watchpoints
+    inline uint16_t fetch_vector(uint16_t addr) {
+        return fetch(addr) | (fetch(addr+1) << 8);
+    }
+
+    // Reads the 0, 1 or 2 operand bytes following the opcode at PC
+    inline uint16_t fetch_operand(uint8_t length) {
+        switch (length) {
+            case 0: return 0;
+            case 1: return fetch(PC+1);
+            default: return fetch(PC+1) | (fetch(PC+2) << 8);
+        }
+    }
+
+    // Addressing modes return the effective address of the operand,
+    // given the instruction's operand bytes as a little-endian word
+    // PC is already on the last byte of the instruction
+    uint16_t Addr_ACC(uint16_t operand); // Accumulator, the operation uses A directly
+    uint16_t Addr_IMM(uint16_t operand); // Immediate, the address of the operand byte itself
+    uint16_t Addr_ABS(uint16_t operand); // Absolute
+    uint16_t Addr_ZER(uint16_t operand); // Zero page
+    uint16_t Addr_ZEX(uint16_t operand); // Zero page, X-indexed
+    uint16_t Addr_ZEY(uint16_t operand); // Zero page, Y-indexed
+    uint16_t Addr_ABX(uint16_t operand); // Absolute, X-indexed
+    uint16_t Addr_ABY(uint16_t operand); // Absolute, Y-indexed
+    uint16_t Addr_IMP(uint16_t operand); // Implied, no operand
+    uint16_t Addr_REL(uint16_t operand); // Relative, the branch target less one
+    uint16_t Addr_INX(uint16_t operand); // Indirect, X-indexed
+    uint16_t Addr_INY(uint16_t operand); // Indirect, Y-indexed
+    uint16_t Addr_ABI(uint16_t operand); // Absolute indirect
+
+    uint16_t indexed(uint16_t base, uint8_t index);
+
+    // Every opcode is dispatched through a flat table of handlers, each of which
+    // has its addressing mode and operation bound at compile time
+    // The table is derived from Instructions::info, and built by the compiler
+    using handler_t = void (CPU6502::*)(uint16_t operand);
+    using opcode_table_t = std::array<handler_t, 0x100>;
+    static const opcode_table_t opcode_table;
+
+    using mode_f_t = uint16_t (CPU6502::*)(uint16_t operand);
+    using op_f_t = void (CPU6502::*)(uint16_t addr);
+    static constexpr op_f_t operation(Op op, Mode mode);
+    static constexpr mode_f_t addressing(Mode mode);
+    static constexpr bool page_penalty(Op op, Mode mode);
+    template <uint8_t opcode> static constexpr handler_t opcode_handler();
+    template <size_t... opcodes> static constexpr opcode_table_t generate_opcode_table(std::index_sequence<opcodes...>);
+
+    // Executes a decoded instruction, with PC still on its opcode
+    inline void dispatch(handler_t handler, uint8_t opcode, uint16_t operand, uint8_t length) {
+        PC += length;
+        (this->*handler)(operand);
+        PC++;
+        cycles_left = Instructions::cycle_table[opcode] + extra_cycles;
+        total_cycles += cycles_left;
+        extra_cycles = 0;
+    }
+
+    typedef struct DecodedInstruction {
+        handler_t handler; // Null past the end of a block
+        uint16_t operand;
+        uint8_t opcode;
+        uint8_t length;
+    } DecodedInstruction;
+
+    // A block runs from its start address to the first jump, return, BRK or illegal opcode,
+    // or to the last instruction that fits entirely within the same page
+    // Conditional branches do not end a block, so loops can fall through them
+    using Block = std::vector<DecodedInstruction>;
+    using BlockPage = std::array<std::unique_ptr<Block>, 0x100>; // By low byte of start address
+
+    bool block_cache = false;
+    std::array<std::unique_ptr<BlockPage>, 0x100> blocks;
+
+    // Non-zero for each byte of the instructions held by the block cache or the JIT,
+    // allocated once either is enabled
+    std::unique_ptr<uint8_t[]> code_map;
+#ifdef CPU6502_JIT
+    std::unique_ptr<JitX64> jit;
+#endif
+
+    // Invalidated blocks are only freed once no block is being executed
+    std::vector<std::unique_ptr<BlockPage>> retired_blocks;
+
+    // The rest of the current block, valid as long as execution carries on at next_decoded_PC
+    const DecodedInstruction *next_decoded = nullptr;
+    uint16_t next_decoded_PC;
+
+    const DecodedInstruction *find_block(uint16_t addr);
+    void invalidate_page(uint8_t page);
+
+    // Computes the operand address for an addressing mode, then applies an operation to it
+    // Instructions that only read their operand take a cycle longer when indexing crosses a page
+    template <mode_f_t mode_f, op_f_t op_f, bool penalty=false>
+    void execute(uint16_t operand) {
+        uint16_t addr = (this->*mode_f)(operand);
+        if (penalty) extra_cycles += page_crossed;
+        (this->*op_f)(addr);
+    }
+
+    // Handler for opcodes that have no instruction
+    void illegal(uint16_t operand);
 
     /*
      * These functions abstract similar instructions
      */
+    template <class F> void bit_op(uint16_t addr);
+    template <uint8_t flag, bool value=true> void branch_op(uint16_t addr);
+    template <uint8_t flag, bool value=true> void set_op(uint16_t addr);
+    template <uint8_t CPU6502::*reg> void compare_op(uint16_t addr);
+    template <bool decrement=false> void step_op(uint16_t addr);
+    template <uint8_t CPU6502::*reg, bool decrement=false> void step_reg_op(uint16_t addr);
+    template <uint8_t CPU6502::*reg> void load_op(uint16_t addr);
+    template <uint8_t CPU6502::*reg> void store_op(uint16_t addr);
+    template <uint8_t CPU6502::*reg> void push_op(uint16_t addr);
+    template <uint8_t CPU6502::*reg> void pop_op(uint16_t addr);
+    template <uint8_t CPU6502::*reg_a, uint8_t CPU6502::*reg_b, bool flags=true> void transfer_op(uint16_t addr); // a -> b
+    void nop_op(uint16_t addr) {}
+
+    // Read-modify-write of memory or of the accumulator, with the modification done by op_f
+    template <uint8_t (CPU6502::*op_f)(uint8_t)> void modify_op(uint16_t addr);
+    template <uint8_t (CPU6502::*op_f)(uint8_t)> void modify_acc_op(uint16_t addr);
+
+    // More complex or unique instructions
+    void Op_ADC(uint16_t addr);
+    void Op_BIT(uint16_t addr);
+    void Op_BRK(uint16_t addr);
+    void Op_JMP(uint16_t addr);
+    void Op_JSR(uint16_t addr);
+    void Op_PHP(uint16_t addr);
+    void Op_PLP(uint16_t addr);
+    void Op_RTI(uint16_t addr);
+    void Op_RTS(uint16_t addr);
+    void Op_SBC(uint16_t addr);
+
+    // Shifts and rotates, to be used with modify_op and modify_acc_op
+    uint8_t Op_ASL(uint8_t data);
+    uint8_t Op_LSR(uint8_t data);
+    uint8_t Op_ROL(uint8_t data);
+    uint8_t Op_ROR(uint8_t data);
+
+    // The exact value of P, with N and Z evaluated
+    inline uint8_t status() const {
+        return P | (n_result & NEGATIVE) | (z_result ? 0 : ZERO);
+    }
 
-    // Binds a function to the type of an instr_funcs
-    inline std::function<void(uint8_t&)> bind_op(void (CPU6502::*op_f)(uint8_t&)) {
-        return std::bind(op_f, this, std::placeholders::_1);
+    inline void set_status(uint8_t status) {
+        P = status & ~(NEGATIVE | ZERO);
+        n_result = status;
+        z_result = ~status & ZERO;
     }
 
-    // Binds a mode to the type of mode_funcs
-    inline std::function<uint8_t&(void)> bind_mode(uint8_t &(CPU6502::*mode_f)(void)) {
-        return std::bind(mode_f, this);
+    // Sets N and Z from a result, as almost every instruction does
+    inline void set_nz(uint8_t result) {
+        n_result = result;
+        z_result = result;
     }
 
-    // Various abstractions of similar instructions
-    inline std::function<void(uint8_t&)> bit_op(std::function<uint8_t(uint8_t,uint8_t)> f);
-    inline std::function<void(uint8_t&)> branch_op(uint8_t flag, bool value=true);
-    inline std::function<void(uint8_t&)> set_op(uint8_t flag, bool value=true);
-    inline std::function<void(uint8_t&)> compare_op(uint8_t &reg);
-    inline std::function<void(uint8_t&)> step_op(bool decrement=false);
-    inline std::function<void(uint8_t&)> step_reg_op(uint8_t &reg, bool decrement=false);
-    inline std::function<void(uint8_t&)> load_op(uint8_t &reg);
-    inline std::function<void(uint8_t&)> store_op(const uint8_t &reg);
-    inline std::function<void(uint8_t&)> push_op(const uint8_t &reg);
-    inline std::function<void(uint8_t&)> pop_op(uint8_t &reg);
-    inline std::function<void(uint8_t&)> transfer_op(const uint8_t &reg_a, uint8_t &reg_b); // a -> b
-
-    // More complex or unique instructions, to be used with bind_op
-    void Op_ADC(uint8_t&);
-    void Op_ASL(uint8_t&);
-    void Op_BIT(uint8_t&);
-    void Op_BRK(uint8_t&);
-    void Op_JMP(uint8_t&);
-    void Op_JSR(uint8_t&);
-    void Op_LSR(uint8_t&);
-    void Op_ROL(uint8_t&);
-    void Op_ROR(uint8_t&);
-    void Op_RTI(uint8_t&);
-    void Op_RTS(uint8_t&);
-    void Op_SBC(uint8_t&);
-
-    void execute(InstrInfo info);
+    inline void set_carry(bool carry) {
+        P = (P & ~CARRY) | carry;
+    }
 
     unsigned char get_flag(uint8_t mask);
-    void set_flag(uint8_t mask, unsigned char val);
 
-    // Translates a binary integer to a "Binary Coded Decimal"
-    // i.e. decimal(49) => 0x49
-    uint8_t to_bcd(uint8_t x);
-
-    // Translates "Binary Coded Decimal" to a binary integer
-    // i.e. 0x49 => decimal(49)
-    uint8_t from_bcd(uint8_t x);
+    // Only for the flags held in P, not N or Z
+    void set_flag(uint8_t mask, unsigned char val);
 
     void stack_push(uint8_t data);
     void stack_push_word(uint16_t data);
@@ -133,4 +478,47 @@ class CPU6502 {
     uint16_t stack_pop_word();
 };
 
+template <class Bus>
+template <class Pred>
+RunResult CPU6502<Bus>::run(uint64_t budget, uint64_t instructions, Pred &pred, bool native) {
+    uint64_t used = 0;
+    while (used < budget) {
+        if (cycles_left == 0) {
+            if (halted) return { used, StopReason::HALT };
+            if (run_events() || sample_irq()) continue;
+            if (debugger && debugger->stop_at(PC)) {
+                return { used, debugger->watch_hit() ? StopReason::WATCHPOINT : StopReason::BREAKPOINT };
+            }
+            if (instructions == 0) return { used, StopReason::BUDGET };
+            if (pred()) return { used, StopReason::BREAKPOINT };
+            if (stop_requested || PC == stop_pc) {
+                if (stop_requested) stop_requested = false;
+                else stop_pc = no_stop_pc;
+                return { used, StopReason::BREAKPOINT };
+            }
+            if (stop_on_brk && fetch(PC) == 0x00) return { used, StopReason::BRK };
+
+            uint64_t until_event = events ? events->next_due() - total_cycles : budget - used;
+            uint64_t slice = std::min(budget - used, until_event);
+            if (native && !irq_line && execute_native(slice)) {
+                instructions--;
+            } else if (!std::is_same<Pred, NoStop>::value || irq_line || !batch_blocks() ||
+                       !execute_block(slice, used, instructions, native)) {
+                execute_instruction();
+                instructions--;
+            }
+        }
+
+        // Idle cycles are consumed in one go rather than one call per cycle
+        uint64_t idle = std::min<uint64_t>(cycles_left, budget - used);
+        cycles_left -= idle;
+        used += idle;
+    }
+    return { used, StopReason::BUDGET };
+}
+
+extern template class CPU6502<Memory>;
+extern template class CPU6502<RAM<0x10000>>;
+extern template class CPU6502<PagedMemory>;
+
 #endif // CPU_6502
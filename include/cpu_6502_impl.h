@@ -0,0 +1,771 @@
+#ifndef CPU_6502_IMPL
+#define CPU_6502_IMPL
+
+// Definitions for CPU6502, for instantiating it with buses the library does not ship
+
+#include "cpu_6502.h"
+
+template <class Bus>
+const PageTable CPU6502<Bus>::no_pages = {};
+
+template <class Bus>
+CPU6502<Bus>::CPU6502(std::shared_ptr<Bus> mem)
+        : mem{mem}, pages{&no_pages} {
+    if constexpr (std::is_base_of<Memory, Bus>::value) {
+        if (const PageTable *table = mem->page_table()) pages = table;
+    }
+    reset();
+}
+
+// Each instruction's operation, on memory for an addressing mode that has an address
+template <class Bus>
+constexpr typename CPU6502<Bus>::op_f_t CPU6502<Bus>::operation(Op op, Mode mode) {
+    bool acc = mode == Mode::ACC;
+    switch (op) {
+        case Op::ADC: return &CPU6502::Op_ADC;
+        case Op::AND: return &CPU6502::bit_op<std::bit_and<uint8_t>>;
+        case Op::ASL: return acc ? &CPU6502::modify_acc_op<&CPU6502::Op_ASL> : &CPU6502::modify_op<&CPU6502::Op_ASL>;
+        case Op::BCC: return &CPU6502::branch_op<CARRY, false>;
+        case Op::BCS: return &CPU6502::branch_op<CARRY>;
+        case Op::BEQ: return &CPU6502::branch_op<ZERO>;
+        case Op::BIT: return &CPU6502::Op_BIT;
+        case Op::BMI: return &CPU6502::branch_op<NEGATIVE>;
+        case Op::BNE: return &CPU6502::branch_op<ZERO, false>;
+        case Op::BPL: return &CPU6502::branch_op<NEGATIVE, false>;
+        case Op::BRK: return &CPU6502::Op_BRK;
+        case Op::BVC: return &CPU6502::branch_op<OVERFLOW, false>;
+        case Op::BVS: return &CPU6502::branch_op<OVERFLOW>;
+        case Op::CLC: return &CPU6502::set_op<CARRY, false>;
+        case Op::CLD: return &CPU6502::set_op<DECIMAL, false>;
+        case Op::CLI: return &CPU6502::set_op<INTERRUPT, false>;
+        case Op::CLV: return &CPU6502::set_op<OVERFLOW, false>;
+        case Op::CMP: return &CPU6502::compare_op<&CPU6502::A>;
+        case Op::CPX: return &CPU6502::compare_op<&CPU6502::X>;
+        case Op::CPY: return &CPU6502::compare_op<&CPU6502::Y>;
+        case Op::DEC: return &CPU6502::step_op<true>;
+        case Op::DEX: return &CPU6502::step_reg_op<&CPU6502::X, true>;
+        case Op::DEY: return &CPU6502::step_reg_op<&CPU6502::Y, true>;
+        case Op::EOR: return &CPU6502::bit_op<std::bit_xor<uint8_t>>;
+        case Op::INC: return &CPU6502::step_op<false>;
+        case Op::INX: return &CPU6502::step_reg_op<&CPU6502::X>;
+        case Op::INY: return &CPU6502::step_reg_op<&CPU6502::Y>;
+        case Op::JMP: return &CPU6502::Op_JMP;
+        case Op::JSR: return &CPU6502::Op_JSR;
+        case Op::LDA: return &CPU6502::load_op<&CPU6502::A>;
+        case Op::LDX: return &CPU6502::load_op<&CPU6502::X>;
+        case Op::LDY: return &CPU6502::load_op<&CPU6502::Y>;
+        case Op::LSR: return acc ? &CPU6502::modify_acc_op<&CPU6502::Op_LSR> : &CPU6502::modify_op<&CPU6502::Op_LSR>;
+        case Op::NOP: return &CPU6502::nop_op;
+        case Op::ORA: return &CPU6502::bit_op<std::bit_or<uint8_t>>;
+        case Op::PHA: return &CPU6502::push_op<&CPU6502::A>;
+        case Op::PHP: return &CPU6502::Op_PHP;
+        case Op::PLA: return &CPU6502::pop_op<&CPU6502::A>;
+        case Op::PLP: return &CPU6502::Op_PLP;
+        case Op::ROL: return acc ? &CPU6502::modify_acc_op<&CPU6502::Op_ROL> : &CPU6502::modify_op<&CPU6502::Op_ROL>;
+        case Op::ROR: return acc ? &CPU6502::modify_acc_op<&CPU6502::Op_ROR> : &CPU6502::modify_op<&CPU6502::Op_ROR>;
+        case Op::RTI: return &CPU6502::Op_RTI;
+        case Op::RTS: return &CPU6502::Op_RTS;
+        case Op::SBC: return &CPU6502::Op_SBC;
+        case Op::SEC: return &CPU6502::set_op<CARRY>;
+        case Op::SED: return &CPU6502::set_op<DECIMAL>;
+        case Op::SEI: return &CPU6502::set_op<INTERRUPT>;
+        case Op::STA: return &CPU6502::store_op<&CPU6502::A>;
+        case Op::STX: return &CPU6502::store_op<&CPU6502::X>;
+        case Op::STY: return &CPU6502::store_op<&CPU6502::Y>;
+        case Op::TAX: return &CPU6502::transfer_op<&CPU6502::A, &CPU6502::X>;
+        case Op::TAY: return &CPU6502::transfer_op<&CPU6502::A, &CPU6502::Y>;
+        case Op::TSX: return &CPU6502::transfer_op<&CPU6502::S, &CPU6502::X>;
+        case Op::TXA: return &CPU6502::transfer_op<&CPU6502::X, &CPU6502::A>;
+        case Op::TXS: return &CPU6502::transfer_op<&CPU6502::X, &CPU6502::S, false>;
+        case Op::TYA: return &CPU6502::transfer_op<&CPU6502::Y, &CPU6502::A>;
+        default: return &CPU6502::illegal;
+    }
+}
+
+template <class Bus>
+constexpr typename CPU6502<Bus>::mode_f_t CPU6502<Bus>::addressing(Mode mode) {
+    switch (mode) {
+        case Mode::ACC: return &CPU6502::Addr_ACC;
+        case Mode::IMM: return &CPU6502::Addr_IMM;
+        case Mode::ZER: return &CPU6502::Addr_ZER;
+        case Mode::ZEX: return &CPU6502::Addr_ZEX;
+        case Mode::ZEY: return &CPU6502::Addr_ZEY;
+        case Mode::ABS: return &CPU6502::Addr_ABS;
+        case Mode::ABX: return &CPU6502::Addr_ABX;
+        case Mode::ABY: return &CPU6502::Addr_ABY;
+        case Mode::INX: return &CPU6502::Addr_INX;
+        case Mode::INY: return &CPU6502::Addr_INY;
+        case Mode::REL: return &CPU6502::Addr_REL;
+        case Mode::ABI: return &CPU6502::Addr_ABI;
+        default: return &CPU6502::Addr_IMP;
+    }
+}
+
+// Only instructions that read their operand without writing it pay for an indexed page crossing
+template <class Bus>
+constexpr bool CPU6502<Bus>::page_penalty(Op op, Mode mode) {
+    if (mode != Mode::ABX && mode != Mode::ABY && mode != Mode::INY) return false;
+    switch (op) {
+        case Op::ADC: case Op::AND: case Op::CMP: case Op::EOR: case Op::LDA:
+        case Op::LDX: case Op::LDY: case Op::ORA: case Op::SBC:
+            return true;
+        default:
+            return false;
+    }
+}
+
+template <class Bus>
+template <uint8_t opcode>
+constexpr typename CPU6502<Bus>::handler_t CPU6502<Bus>::opcode_handler() {
+    constexpr InstrInfo info = Instructions::info[opcode];
+    if constexpr (info.op == Op::ILLEGAL) return &CPU6502::illegal;
+    else return &CPU6502::execute<addressing(info.mode), operation(info.op, info.mode), page_penalty(info.op, info.mode)>;
+}
+
+template <class Bus>
+template <size_t... opcodes>
+constexpr typename CPU6502<Bus>::opcode_table_t CPU6502<Bus>::generate_opcode_table(std::index_sequence<opcodes...>) {
+    return {{ opcode_handler<opcodes>()... }};
+}
+
+template <class Bus>
+const typename CPU6502<Bus>::opcode_table_t CPU6502<Bus>::opcode_table =
+    CPU6502<Bus>::generate_opcode_table(std::make_index_sequence<0x100>());
+
+template <class Bus>
+void CPU6502<Bus>::step() {
+    if (halted) return;
+
+    if (cycles_left == 0 && !run_events() && !sample_irq()) {
+        execute_instruction();
+    }
+    // The cycle that executes an instruction counts towards its total
+    if (cycles_left > 0) cycles_left--;
+}
+
+template <class Bus>
+RunResult CPU6502<Bus>::run_cycles(uint64_t budget) {
+    NoStop never;
+    return run(budget, std::numeric_limits<uint64_t>::max(), never, true);
+}
+
+template <class Bus>
+RunResult CPU6502<Bus>::run_instructions(uint64_t count) {
+    NoStop never;
+    return run(std::numeric_limits<uint64_t>::max(), count, never);
+}
+
+template <class Bus>
+void CPU6502<Bus>::execute_instruction() {
+#ifdef CPU6502_TRACE
+    if (trace_level != TraceLevel::OFF) {
+        execute_traced(fetch(PC));
+        return;
+    }
+#endif
+#ifdef CPU6502_PROFILE
+    if (profiler) {
+        execute_profiled(fetch(PC));
+        return;
+    }
+#endif
+    uint8_t opcode = fetch(PC);
+    uint8_t length = Instructions::length_table[opcode];
+    dispatch(opcode_table[opcode], opcode, fetch_operand(length), length);
+}
+
+template <class Bus>
+void CPU6502<Bus>::set_trace(std::shared_ptr<TraceBuffer> buffer, TraceLevel level) {
+    trace = buffer;
+    trace_level = buffer ? level : TraceLevel::OFF;
+}
+
+// Same as execute_instruction, but records the state beforehand
+template <class Bus>
+void CPU6502<Bus>::execute_traced(uint8_t opcode) {
+    uint8_t length = Instructions::length_table[opcode];
+    uint16_t operand = fetch_operand(length);
+
+    TraceRecord &record = trace->next();
+    record = { total_cycles, PC, operand, opcode, A, X, Y, status(), S };
+    uint16_t next_PC = PC + length + 1;
+
+    dispatch(opcode_table[opcode], opcode, operand, length);
+
+    if (trace_level == TraceLevel::ALL || PC != next_PC) {
+        trace->commit();
+    }
+}
+
+// Same as execute_instruction, but counts the instruction and follows calls and returns
+template <class Bus>
+void CPU6502<Bus>::execute_profiled(uint8_t opcode) {
+    uint8_t length = Instructions::length_table[opcode];
+    uint16_t operand = fetch_operand(length);
+    uint16_t start_PC = PC;
+    uint8_t start_S = S;
+
+    dispatch(opcode_table[opcode], opcode, operand, length);
+    profiler->record(start_PC, opcode, operand, cycles_left, cycles_left - Instructions::cycle_table[opcode]);
+
+    switch (opcode) {
+        case 0x00: // BRK
+        case 0x20: // JSR
+            profiler->call(PC, start_S);
+            break;
+        case 0x40: // RTI
+        case 0x60: // RTS
+            profiler->ret(S);
+            break;
+    }
+}
+
+// Blocks only run from run() when nothing needs to look at the CPU between their instructions
+template <class Bus>
+bool CPU6502<Bus>::batch_blocks() const {
+    if (!block_cache || debugger) return false;
+#ifdef CPU6502_TRACE
+    if (trace_level != TraceLevel::OFF) return false;
+#endif
+#ifdef CPU6502_PROFILE
+    if (profiler) return false;
+#endif
+    return true;
+}
+
+template <class Bus>
+bool CPU6502<Bus>::execute_block(uint64_t slice, uint64_t &used, uint64_t &instructions, bool native) {
+    const DecodedInstruction *instr = next_decoded;
+    if (!instr || PC != next_decoded_PC) {
+        instr = find_block(PC);
+        if (!instr) return false;
+    }
+
+    uint64_t ran = 0;
+    for (;;) {
+        // Set up before executing, so that a store invalidating this block can clear it
+        next_decoded_PC = PC + instr->length + 1;
+        next_decoded = (instr+1)->handler ? instr+1 : nullptr;
+        dispatch(instr->handler, instr->opcode, instr->operand, instr->length);
+        instructions--;
+
+        if (instructions == 0 || ran + cycles_left >= slice) break;
+        ran += cycles_left;
+        cycles_left = 0;
+        if (stop_requested || PC == stop_pc) break;
+
+        // Leaving the block, by its end or a taken branch, is where run() would look at the CPU
+        instr = next_decoded;
+        if (!instr || PC != next_decoded_PC) {
+            if (halted || (events && events->next_due() <= total_cycles)) break;
+#ifdef CPU6502_JIT
+            if (native && jit) break;
+#endif
+            instr = find_block(PC);
+            if (!instr) break;
+        }
+        if (stop_on_brk && instr->opcode == 0x00) break;
+    }
+    used += ran;
+    return true;
+}
+
+// Returns the first instruction of the block starting at addr, decoding it if needed
+template <class Bus>
+const typename CPU6502<Bus>::DecodedInstruction *CPU6502<Bus>::find_block(uint16_t addr) {
+    retired_blocks.clear();
+
+    uint8_t page = addr >> 8;
+    if (blocks[page] && (*blocks[page])[addr & 0xFF]) {
+        return (*blocks[page])[addr & 0xFF]->data();
+    }
+    // Code in I/O pages is fetched through read_byte every time
+    if (pages != &no_pages && !pages->read[page]) return nullptr;
+
+    auto block = std::make_unique<Block>();
+    for (int offset = addr & 0xFF; offset < 0x100; ) {
+        uint16_t pc = (page << 8) | offset;
+        uint8_t opcode = fetch(pc);
+        uint8_t length = Instructions::length_table[opcode];
+        if (offset + length > 0xFF) break;
+
+        handler_t handler = opcode_table[opcode];
+        uint16_t operand = (length == 0) ? 0 : (length == 1) ? fetch(pc+1) : fetch(pc+1) | (fetch(pc+2) << 8);
+        block->push_back({ handler, operand, opcode, length });
+        std::fill_n(&code_map[pc], length + 1, 1);
+        offset += length + 1;
+
+        bool ends_block = opcode == 0x00 || opcode == 0x20 || opcode == 0x40 || opcode == 0x4C
+            || opcode == 0x60 || opcode == 0x6C || handler == &CPU6502::illegal;
+        if (ends_block) break;
+    }
+    // An instruction that spills into the next page is not cached
+    if (block->empty()) return nullptr;
+    block->push_back({ nullptr, 0, 0, 0 });
+
+    if (!blocks[page]) blocks[page] = std::make_unique<BlockPage>();
+    (*blocks[page])[addr & 0xFF] = std::move(block);
+    return (*blocks[page])[addr & 0xFF]->data();
+}
+
+template <class Bus>
+uint8_t CPU6502<Bus>::fetch_slow(uint16_t addr) {
+    const uint8_t *page = pages->read_page(addr);
+    return page ? page[addr & 0xFF] : mem->read_byte(addr);
+}
+
+template <class Bus>
+void CPU6502<Bus>::write_slow(uint16_t addr, uint8_t data) {
+    uint8_t *page = pages->write_page(addr);
+    if (page) page[addr & 0xFF] = data;
+    else mem->write_byte(addr, data);
+}
+
+// Drops everything decoded or translated from a page, when any of its code is overwritten
+template <class Bus>
+void CPU6502<Bus>::invalidate_page(uint8_t page) {
+    std::fill_n(&code_map[page << 8], 0x100, 0);
+    if (blocks[page]) retired_blocks.push_back(std::move(blocks[page]));
+    next_decoded = nullptr;
+#ifdef CPU6502_JIT
+    if (jit) jit->invalidate_page(page);
+#endif
+}
+
+template <class Bus>
+void CPU6502<Bus>::invalidate_code(uint16_t start, uint32_t length) {
+    if (length == 0 || !code_map) return;
+    uint32_t last = std::min<uint32_t>(start + length - 1, 0xFFFF);
+    for (uint32_t page = start >> 8; page <= last >> 8; page++) {
+        invalidate_page(page);
+    }
+}
+
+template <class Bus>
+void CPU6502<Bus>::set_block_cache(bool enabled) {
+    invalidate_code();
+    block_cache = enabled;
+    if (enabled && !code_map) code_map = std::make_unique<uint8_t[]>(0x10000);
+}
+
+template <class Bus>
+void CPU6502<Bus>::set_stop_pc(std::optional<uint16_t> addr) {
+    stop_pc = addr ? *addr : no_stop_pc;
+#ifdef CPU6502_JIT
+    // Translations end before the stop PC, and none span pages, so only those of its page can run past it
+    if (jit && addr) jit->invalidate_page(*addr >> 8);
+#endif
+}
+
+template <class Bus>
+void CPU6502<Bus>::set_jit(bool enabled) {
+#ifdef CPU6502_JIT
+    invalidate_code();
+    jit = enabled ? std::make_unique<JitX64>() : nullptr;
+    if (enabled && !code_map) code_map = std::make_unique<uint8_t[]>(0x10000);
+#endif
+}
+
+template <class Bus>
+bool CPU6502<Bus>::execute_native(uint64_t budget) {
+#ifdef CPU6502_JIT
+    if (!jit || trace_level != TraceLevel::OFF) return false;
+#ifdef CPU6502_PROFILE
+    if (profiler) return false;
+#endif
+    if (debugger) return false;
+
+    JitState state = { A, X, Y, status(), S, PC, budget, 0, pages, code_map.get(), stop_pc };
+    // Translated code hands straight back before an instruction it cannot complete
+    if (!jit->execute(state) || state.cycles == 0) return false;
+
+    A = state.A;
+    X = state.X;
+    Y = state.Y;
+    set_status(state.P);
+    S = state.S;
+    PC = state.PC;
+    cycles_left = state.cycles;
+    total_cycles += state.cycles;
+    return true;
+#else
+    return false;
+#endif
+}
+
+template <class Bus>
+CPUState CPU6502<Bus>::save_state() const {
+    return { get_registers(), cycles_left, total_cycles, halted, irq_line };
+}
+
+template <class Bus>
+void CPU6502<Bus>::load_state(const CPUState &state) {
+    A = state.registers.A;
+    X = state.registers.X;
+    Y = state.registers.Y;
+    set_status(state.registers.P);
+    S = state.registers.S;
+    PC = state.registers.PC;
+    cycles_left = state.cycles_left;
+    total_cycles = state.total_cycles;
+    halted = state.halted;
+    irq_line = state.irq_line;
+}
+
+template <class Bus>
+void CPU6502<Bus>::reset() {
+    A = 0x00;
+    X = 0x00;
+    Y = 0x00;
+    set_status(CONSTANT);
+    S = 0xff;
+
+    PC = fetch_vector(RST_VEC);
+
+    cycles_left = 0;
+    extra_cycles = 0;
+    halted = false;
+}
+
+// Charges cycles taken outside of an instruction, e.g. by an interrupt sequence
+template <class Bus>
+void CPU6502<Bus>::add_cycles(int cycles) {
+    cycles_left += cycles;
+    total_cycles += cycles;
+}
+
+// Interrupts are taken between instructions, so PC already holds the return address
+template <class Bus>
+void CPU6502<Bus>::nmi() {
+    stack_push_word(PC);
+    stack_push((status() & ~BREAK) | CONSTANT);
+    set_flag(INTERRUPT, 1);
+    PC = fetch_vector(NMI_VEC);
+    add_cycles(7);
+#ifdef CPU6502_PROFILE
+    if (profiler) profiler->call(PC, S + 3);
+#endif
+}
+
+template <class Bus>
+void CPU6502<Bus>::irq() {
+    if (get_flag(INTERRUPT)) return;
+
+    stack_push_word(PC);
+    stack_push((status() & ~BREAK) | CONSTANT);
+    set_flag(INTERRUPT, 1);
+    PC = fetch_vector(IRQ_VEC);
+    add_cycles(7);
+#ifdef CPU6502_PROFILE
+    if (profiler) profiler->call(PC, S + 3);
+#endif
+}
+
+// Illegal opcodes jam the CPU, like the KIL opcodes of the NMOS 6502
+template <class Bus>
+void CPU6502<Bus>::illegal(uint16_t) {
+    halted = true;
+    PC--; // Stay on the offending opcode
+}
+
+// Returns the result of a binary logic operation (e.g. AND) between A and memory
+template <class Bus>
+template <class F>
+void CPU6502<Bus>::bit_op(uint16_t addr) {
+    A = F()(A, read(addr));
+    set_nz(A);
+}
+
+// Branch if value, which costs one more cycle, or two if the target is on another page
+template <class Bus>
+template <uint8_t flag, bool value>
+void CPU6502<Bus>::branch_op(uint16_t addr) {
+    if (get_flag(flag) == value) {
+        extra_cycles += (((PC+1) ^ (addr+1)) & 0xFF00) ? 2 : 1;
+        PC = addr;
+    }
+}
+
+// Set a flag to a predefined value
+template <class Bus>
+template <uint8_t flag, bool value>
+void CPU6502<Bus>::set_op(uint16_t addr) {
+    set_flag(flag, value);
+}
+
+// Compare a register to memory, then set flags
+template <class Bus>
+template <uint8_t CPU6502<Bus>::*reg>
+void CPU6502<Bus>::compare_op(uint16_t addr) {
+    uint8_t data = read(addr);
+    set_nz(this->*reg - data);
+    set_carry(this->*reg >= data);
+}
+
+// Either increment or decrement memory
+template <class Bus>
+template <bool decrement>
+void CPU6502<Bus>::step_op(uint16_t addr) {
+    uint8_t data = read(addr) + (decrement ? -1 : 1);
+    write(addr, data);
+    set_nz(data);
+}
+
+// Increment or decrement a register
+template <class Bus>
+template <uint8_t CPU6502<Bus>::*reg, bool decrement>
+void CPU6502<Bus>::step_reg_op(uint16_t) {
+    this->*reg += (decrement ? -1 : 1);
+    set_nz(this->*reg);
+}
+
+template <class Bus>
+template <uint8_t CPU6502<Bus>::*reg>
+void CPU6502<Bus>::load_op(uint16_t addr) {
+    this->*reg = read(addr);
+    set_nz(this->*reg);
+}
+
+template <class Bus>
+template <uint8_t CPU6502<Bus>::*reg>
+void CPU6502<Bus>::store_op(uint16_t addr) {
+    write(addr, this->*reg);
+}
+
+template <class Bus>
+template <uint8_t CPU6502<Bus>::*reg>
+void CPU6502<Bus>::push_op(uint16_t addr) {
+    stack_push(this->*reg);
+}
+
+template <class Bus>
+template <uint8_t CPU6502<Bus>::*reg>
+void CPU6502<Bus>::pop_op(uint16_t addr) {
+    this->*reg = stack_pop();
+    set_nz(this->*reg);
+}
+
+// TXS is the only transfer that leaves the flags alone
+template <class Bus>
+template <uint8_t CPU6502<Bus>::*reg_a, uint8_t CPU6502<Bus>::*reg_b, bool flags>
+void CPU6502<Bus>::transfer_op(uint16_t addr) {
+    this->*reg_b = this->*reg_a;
+    if (flags) {
+        set_nz(this->*reg_b);
+    }
+}
+
+template <class Bus>
+template <uint8_t (CPU6502<Bus>::*op_f)(uint8_t)>
+void CPU6502<Bus>::modify_op(uint16_t addr) {
+    write(addr, (this->*op_f)(read(addr)));
+}
+
+template <class Bus>
+template <uint8_t (CPU6502<Bus>::*op_f)(uint8_t)>
+void CPU6502<Bus>::modify_acc_op(uint16_t) {
+    A = (this->*op_f)(A);
+}
+
+template <class Bus> uint16_t CPU6502<Bus>::Addr_ACC(uint16_t) { return 0; }
+template <class Bus> uint16_t CPU6502<Bus>::Addr_IMM(uint16_t) { return PC; }
+template <class Bus> uint16_t CPU6502<Bus>::Addr_ABS(uint16_t operand) { return operand; }
+template <class Bus> uint16_t CPU6502<Bus>::Addr_ZER(uint16_t operand) { return operand; }
+template <class Bus> uint16_t CPU6502<Bus>::Addr_ZEX(uint16_t operand) { return (operand + X) & 0xFF; }
+template <class Bus> uint16_t CPU6502<Bus>::Addr_ZEY(uint16_t operand) { return (operand + Y) & 0xFF; }
+template <class Bus> uint16_t CPU6502<Bus>::Addr_ABX(uint16_t operand) { return indexed(operand, X); }
+template <class Bus> uint16_t CPU6502<Bus>::Addr_ABY(uint16_t operand) { return indexed(operand, Y); }
+template <class Bus> uint16_t CPU6502<Bus>::Addr_IMP(uint16_t) { return 0; }
+template <class Bus> uint16_t CPU6502<Bus>::Addr_REL(uint16_t operand) { return PC + (int8_t) operand; }
+
+// The pointer for the indirect modes is read from the zero page, wrapping within it
+template <class Bus>
+uint16_t CPU6502<Bus>::Addr_INX(uint16_t operand) {
+    uint8_t zp = operand + X;
+    return read(zp) | (read((uint8_t) (zp+1)) << 8);
+}
+
+template <class Bus>
+uint16_t CPU6502<Bus>::Addr_INY(uint16_t operand) {
+    uint8_t zp = operand;
+    return indexed(read(zp) | (read((uint8_t) (zp+1)) << 8), Y);
+}
+
+// Adds an index to a base address, noting whether that crossed into the next page
+template <class Bus>
+uint16_t CPU6502<Bus>::indexed(uint16_t base, uint8_t index) {
+    uint16_t addr = base + index;
+    page_crossed = (addr ^ base) & 0xFF00;
+    return addr;
+}
+
+// Like the NMOS 6502, the high byte of the pointer does not carry into the next page
+template <class Bus>
+uint16_t CPU6502<Bus>::Addr_ABI(uint16_t operand) {
+    uint16_t ptr = operand;
+    return read(ptr) | (read((ptr & 0xFF00) | ((ptr+1) & 0x00FF)) << 8);
+}
+
+// Add memory to accumulator with carry
+template <class Bus>
+void CPU6502<Bus>::Op_ADC(uint16_t addr) {
+    uint16_t result = Arithmetic::adc_table[Arithmetic::index(A, read(addr), P)];
+    A = result & 0xFF;
+    P = (P & ~(OVERFLOW | CARRY)) | ((result >> 8) & (OVERFLOW | CARRY));
+    // Not necessarily from A, in decimal mode
+    n_result = result >> 8;
+    z_result = ~(result >> 8) & ZERO;
+}
+
+// Arithmetic shift left, with carry
+// C <- [76543210] <- 0
+template <class Bus>
+uint8_t CPU6502<Bus>::Op_ASL(uint8_t data) {
+    set_carry(data & 0x80);
+    data <<= 1;
+    set_nz(data);
+    return data;
+}
+
+// Test bits in memory with accumulator
+// 2 most significant bits are transferred from data to P [Flags N and V]
+// Then Flag Z is set according to data & A
+template <class Bus>
+void CPU6502<Bus>::Op_BIT(uint16_t addr) {
+    uint8_t data = read(addr);
+    P = (P & ~OVERFLOW) | (data & OVERFLOW);
+    n_result = data;
+    z_result = data & A;
+}
+
+// Force a system interrupt
+// The return address skips the padding byte after BRK
+template <class Bus>
+void CPU6502<Bus>::Op_BRK(uint16_t addr) {
+    stack_push_word(PC+2);
+    stack_push(status() | BREAK | CONSTANT);
+    set_flag(INTERRUPT, 1);
+    PC = fetch_vector(IRQ_VEC) - 1;
+}
+
+// Jump PC to a given address
+template <class Bus>
+void CPU6502<Bus>::Op_JMP(uint16_t addr) {
+    PC = addr - 1;
+}
+
+// Jump PC to a given address, storing the return address
+// The address pushed is that of the last byte of JSR, which RTS then steps past
+template <class Bus>
+void CPU6502<Bus>::Op_JSR(uint16_t addr) {
+    stack_push_word(PC);
+    PC = addr - 1;
+}
+
+// Push P, with the B flag set to mark a software push
+template <class Bus>
+void CPU6502<Bus>::Op_PHP(uint16_t addr) {
+    stack_push(status() | BREAK | CONSTANT);
+}
+
+// Pull P, where B and the unused bit do not exist in the register itself
+template <class Bus>
+void CPU6502<Bus>::Op_PLP(uint16_t addr) {
+    set_status((stack_pop() & ~BREAK) | CONSTANT);
+}
+
+// Shift right with carry
+// 0 -> [76543210] -> C
+template <class Bus>
+uint8_t CPU6502<Bus>::Op_LSR(uint8_t data) {
+    set_carry(data & 0x1);
+    data >>= 1;
+    set_nz(data);
+    return data;
+}
+
+// Rotate left
+// C <- [76543210] <- C
+template <class Bus>
+uint8_t CPU6502<Bus>::Op_ROL(uint8_t data) {
+    uint8_t carry = P & CARRY;
+    set_carry(data & 0x80);
+    data = (data << 1) | carry;
+    set_nz(data);
+    return data;
+}
+
+// Rotate right
+// C -> [76543210] -> C
+template <class Bus>
+uint8_t CPU6502<Bus>::Op_ROR(uint8_t data) {
+    uint8_t carry = P & CARRY;
+    set_carry(data & 0x1);
+    data = (data >> 1) | (carry << 7);
+    set_nz(data);
+    return data;
+}
+
+// Return from interrupt
+// Unlike RTS, the address pulled is the exact address to resume at
+template <class Bus>
+void CPU6502<Bus>::Op_RTI(uint16_t addr) {
+    set_status((stack_pop() & ~BREAK) | CONSTANT);
+    PC = stack_pop_word() - 1;
+}
+
+// Return from subroutine
+template <class Bus>
+void CPU6502<Bus>::Op_RTS(uint16_t addr) {
+    PC = stack_pop_word();
+}
+
+// Subtract memory from accumulator with borrow
+template <class Bus>
+void CPU6502<Bus>::Op_SBC(uint16_t addr) {
+    uint16_t result = Arithmetic::sbc_table[Arithmetic::index(A, read(addr), P)];
+    A = result & 0xFF;
+    P = (P & ~(OVERFLOW | CARRY)) | ((result >> 8) & (OVERFLOW | CARRY));
+    // Not necessarily from A, in decimal mode
+    n_result = result >> 8;
+    z_result = ~(result >> 8) & ZERO;
+}
+
+template <class Bus>
+unsigned char CPU6502<Bus>::get_flag(uint8_t mask) {
+    return (status() & mask) ? 1 : 0;
+}
+
+template <class Bus>
+void CPU6502<Bus>::set_flag(uint8_t mask, unsigned char val) {
+    P = (val) ? (P | mask) : (P & ~mask);
+}
+
+template <class Bus>
+void CPU6502<Bus>::stack_push(uint8_t data) {
+    write(0x100+S, data);
+    if (S == 0x00) S = 0xFF;
+    else S--;
+}
+
+template <class Bus>
+void CPU6502<Bus>::stack_push_word(uint16_t data) {
+    stack_push((data >> 8) & 0xFF);
+    stack_push(data & 0xFF);
+}
+
+template <class Bus>
+uint8_t CPU6502<Bus>::stack_pop() {
+    if (S == 0xFF) S = 0x00;
+    else S++;
+    uint8_t temp = read(0x100+S);
+    return temp;
+}
+
+template <class Bus>
+uint16_t CPU6502<Bus>::stack_pop_word() {
+    uint8_t low = stack_pop();
+    return low | (stack_pop() << 8);
+}
+
+#endif // CPU_6502_IMPL
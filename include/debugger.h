@@ -0,0 +1,114 @@
+#ifndef DEBUGGER_H
+#define DEBUGGER_H
+
+#include <bitset>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "memory.h"
+
+struct Registers;
+
+// Which accesses a watchpoint catches
+enum class WatchKind {
+    READ = 1,
+    WRITE = 2,
+    ACCESS = 3 // Reads and writes
+};
+
+enum class DebugEventKind {
+    NONE,
+    BREAKPOINT, // PC reached a breakpoint
+    READ,       // An instruction read a watched address
+    WRITE       // An instruction wrote a watched address
+};
+
+// What stopped the last run, as seen by the debugger
+typedef struct DebugEvent {
+    DebugEventKind kind;
+    uint16_t PC;      // Start of the instruction that made the access, or the breakpoint
+    uint16_t address; // Address accessed, PC for a breakpoint
+    uint8_t value;    // Byte read or written
+} DebugEvent;
+
+// Breakpoints and watchpoints for CPU6502::set_debugger, each a bitmap over the address space,
+// so checking them costs the same however many are set
+//
+// Breakpoints stop a run before the instruction at their address executes
+// Watchpoints stop it after the instruction that made the access completes,
+// so it can be inspected with the access already done
+// Instruction fetches and interrupt or reset vector fetches are not reads as far as watchpoints are concerned
+class Debugger {
+ public:
+    void add_breakpoint(uint16_t addr) { breakpoints.set(addr); }
+    void remove_breakpoint(uint16_t addr) { breakpoints.reset(addr); }
+
+    // length is in bytes, clamped to the end of the address space
+    void add_watchpoint(uint16_t start, uint32_t length=1, WatchKind kind=WatchKind::WRITE);
+    void remove_watchpoint(uint16_t start, uint32_t length=1, WatchKind kind=WatchKind::ACCESS);
+
+    // Removes every breakpoint and watchpoint
+    void clear();
+
+    bool is_breakpoint(uint16_t addr) const { return breakpoints[addr]; }
+    bool is_watched(uint16_t addr, WatchKind kind) const;
+
+    // Valid after a run stopped with StopReason::BREAKPOINT or WATCHPOINT because of this debugger
+    const DebugEvent &event() const { return last_event; }
+
+    // Called by the CPU at every instruction boundary
+    // Returns whether to stop there, for a breakpoint or a watchpoint hit by the last instruction
+    // Resuming from a breakpoint runs the instruction it stopped before
+    inline bool stop_at(uint16_t pc) {
+        bool resuming = pc == resume_PC;
+        resume_PC = -1;
+        if (pending) {
+            pending = false;
+            return true;
+        }
+        if (breakpoints[pc] && !resuming) {
+            last_event = { DebugEventKind::BREAKPOINT, pc, pc, 0 };
+            resume_PC = pc;
+            return true;
+        }
+        instruction_PC = pc;
+        return false;
+    }
+
+    // Called by the CPU on every data access, only the first hit of an instruction is kept
+    inline void on_read(uint16_t addr, uint8_t value) {
+        if (watch_read[addr] && !pending) hit(DebugEventKind::READ, addr, value);
+    }
+
+    inline void on_write(uint16_t addr, uint8_t value) {
+        if (watch_write[addr] && !pending) hit(DebugEventKind::WRITE, addr, value);
+    }
+
+    // Whether the CPU is to stop with StopReason::WATCHPOINT rather than BREAKPOINT
+    bool watch_hit() const { return last_event.kind == DebugEventKind::READ || last_event.kind == DebugEventKind::WRITE; }
+
+    // Inspection while stopped
+    // These read through the Memory interface, so they trigger no watchpoints, but do touch I/O
+    static std::string to_string(const DebugEvent &event);
+    static std::string registers_to_string(const Registers &registers);
+    static void print_memory(std::ostream &out, Memory &mem, uint16_t start, uint32_t length);
+    static void print_disassembly(std::ostream &out, Memory &mem, uint16_t start, size_t count);
+
+ private:
+    std::bitset<0x10000> breakpoints;
+    std::bitset<0x10000> watch_read;
+    std::bitset<0x10000> watch_write;
+
+    DebugEvent last_event = { DebugEventKind::NONE, 0, 0, 0 };
+    bool pending = false;     // A watchpoint was hit by the instruction being executed
+    uint16_t instruction_PC = 0;
+    int32_t resume_PC = -1;   // Breakpoint stopped at last, -1 if none
+
+    void hit(DebugEventKind kind, uint16_t addr, uint8_t value) {
+        last_event = { kind, instruction_PC, addr, value };
+        pending = true;
+    }
+};
+
+#endif // DEBUGGER_H
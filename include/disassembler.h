@@ -1,26 +1,89 @@
 #ifndef DISASSEMBLER_H
 #define DISASSEMBLER_H
 
-#include <map>
-#include <vector>
-#include <fstream>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
 #include <string>
-#include <cstring>
-#include <sstream>
-#include <iomanip>
+#include <vector>
 
 #include "instruction.h"
 
-class Disassembler {
+// A decoded instruction, or a single byte that does not start one
+// (an unknown opcode, or an instruction cut off by the end of the image or bank)
+typedef struct DisasmRecord {
+    uint16_t address;
+    uint16_t operand; // Operand bytes, little-endian
+    uint8_t opcode;
+    uint8_t length;   // Bytes including the opcode, 1 for a data byte
+} DisasmRecord;
+
+// Receives the records of a disassembly in address order, a batch at a time
+class DisasmSink {
  public:
-    Disassembler(uint16_t base) : base(base) {};
-    void file_to_strings(std::ifstream &file);
+    virtual ~DisasmSink() = default;
+    virtual void write(const DisasmRecord *records, size_t count) = 0;
+
+    // Called before the first record of each bank when the image is split into banks
+    virtual void begin_bank(size_t bank) {}
+
+    // Called once the whole image has been written
+    virtual void finish() {}
+};
+
+// Formats records as text into a fixed buffer, writing it out whenever it fills
+class TextSink : public DisasmSink {
+ public:
+    TextSink(std::ostream &out, size_t buffer_size=1 << 16);
+    ~TextSink();
+
+    void write(const DisasmRecord *records, size_t count) override;
+    void begin_bank(size_t bank) override;
+    void finish() override;
 
  private:
-    std::string instr_to_string(InstrInfo info, uint16_t PC, uint16_t src);
+    std::ostream &out;
+    std::vector<char> buffer;
+    size_t used = 0;
 
+    static constexpr size_t max_line_length = 48;
+    void flush();
+};
+
+// Keeps the records themselves, for callers that only need the decoded fields
+class RecordSink : public DisasmSink {
+ public:
+    void write(const DisasmRecord *records, size_t count) override {
+        this->records.insert(this->records.end(), records, records + count);
+    }
+
+    std::vector<DisasmRecord> records;
+};
+
+// Linear disassembler, decoding everything from the start of the image
+class Disassembler {
+ public:
+    // bank_size splits the image into banks that are each mapped at base, 0 for one flat image
+    Disassembler(uint16_t base, size_t bank_size=0) : base(base), bank_size(bank_size) {};
+
+    void disassemble(const uint8_t *data, size_t size, DisasmSink &sink) const;
+
+    // Maps the file into memory rather than reading it, so large images cost no copies
+    void disassemble_file(const std::string &path, DisasmSink &sink) const;
+
+    // Formats the instruction text alone, e.g. "LDA ($20),Y", into out
+    // Returns the number of chars written, at most max_text_length, without a terminator
+    static size_t format(const DisasmRecord &record, char *out);
+    static std::string to_string(const DisasmRecord &record);
+    static const size_t max_text_length = 16;
+
+    static bool is_instruction(uint8_t opcode);
+
+ private:
     uint16_t base; // Start address for program memory
-    std::vector<std::string> instructions;
+    size_t bank_size;
+
+    static const size_t batch_size = 4096; // Records handed to the sink at once
 };
 
 #endif // DISASSEMBLER_H
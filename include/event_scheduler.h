@@ -0,0 +1,77 @@
+#ifndef EVENT_SCHEDULER_H
+#define EVENT_SCHEDULER_H
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+// Device events due at emulated cycles, such as a timer firing, an IRQ being raised or a frame ending,
+// for CPU6502::set_events
+// Devices post events ahead of time instead of being polled around every step,
+// and the CPU runs uninterrupted until the earliest one is due, so devices cost per event and not per cycle
+// Devices whose state only matters when it is read, like a random number generator,
+// are better off computing it in a PagedMemory::map_io handler, without any events at all
+//
+// Not to be confused with Scheduler, which paces the CPU against the host's clock
+class EventScheduler {
+ public:
+    // Called with the cycle the event was due at, which may be a little earlier than the CPU's cycle count,
+    // since events are only run between instructions
+    using callback_t = std::function<void(uint64_t due)>;
+    using id_t = uint64_t;
+
+    static constexpr uint64_t never = std::numeric_limits<uint64_t>::max();
+
+    // Posts callback to run once the CPU's cycle count reaches due, returning an id to cancel it with
+    // Events due at the same cycle run in the order they were posted
+    id_t schedule(uint64_t due, callback_t callback);
+
+    // Returns false if the event has already run or been cancelled
+    // Takes constant time: the event is left in the heap, and dropped when it reaches the front
+    bool cancel(id_t id);
+
+    void clear();
+
+    // Cycle at which the earliest pending event is due, never if there is none
+    inline uint64_t next_due() const { return due; }
+
+    size_t pending() const { return live; }
+
+    // Runs every event due at or before cycle, in order
+    // Callbacks may post and cancel events, and those posted due by cycle run in the same call
+    void run_due(uint64_t cycle);
+
+ private:
+    // An id is a slot's index in its low 32 bits and the slot's generation in its high 32,
+    // which moves on whenever the event in the slot runs or is cancelled, so stale ids and heap entries never match
+    typedef struct Slot {
+        callback_t callback;
+        uint32_t generation;
+    } Slot;
+
+    typedef struct Event {
+        uint64_t due;
+        uint64_t sequence; // Order of posting, to run events due together first come first served
+        id_t id;
+    } Event;
+
+    // A binary heap with the earliest event at the front, which is never a cancelled one
+    std::vector<Event> heap;
+    std::vector<Slot> slots;
+    std::vector<uint32_t> free_slots;
+    uint64_t due = never;
+    uint64_t next_sequence = 0;
+    size_t live = 0;
+
+    bool is_live(id_t id) const {
+        return slots[(uint32_t) id].generation == (uint32_t) (id >> 32);
+    }
+
+    // Frees the slot of a live event, handing back its callback
+    callback_t release(id_t id);
+    void pop();
+    void compact();
+};
+
+#endif // EVENT_SCHEDULER_H
@@ -0,0 +1,105 @@
+#ifndef FLOW_ANALYZER_H
+#define FLOW_ANALYZER_H
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "disassembler.h"
+#include "thread_pool.h"
+
+// An image mapped into the 64 KiB address space at base, and where to start decoding it
+typedef struct FlowImage {
+    const uint8_t *data;
+    size_t size;
+    uint16_t base;
+    bool use_vectors = true;       // Start from the NMI, reset and IRQ vectors, if they lie in the image
+    std::vector<uint16_t> entries; // Further entry points
+} FlowImage;
+
+enum class XrefKind : uint8_t {
+    FALL_THROUGH, // Only used for bad targets, when flow runs on into something that does not decode
+    BRANCH,
+    JUMP,
+    CALL
+};
+
+// Transfer of control from the instruction at from to to
+typedef struct Xref {
+    uint16_t from;
+    uint16_t to;
+    XrefKind kind;
+} Xref;
+
+// In order of precedence, when an address is reached in several ways
+enum class LabelKind : uint8_t {
+    VECTOR,
+    ENTRY,
+    SUBROUTINE,
+    LOCAL
+};
+
+typedef struct Label {
+    LabelKind kind;
+    std::string name;
+} Label;
+
+// Straight-line run of instructions [start, end), entered only at start
+// Calls do not end a block, as they are assumed to return
+typedef struct FlowBlock {
+    uint16_t start;
+    uint16_t end;
+    std::vector<uint16_t> successors;
+} FlowBlock;
+
+// Result of analyzing one image
+class FlowGraph {
+ public:
+    std::vector<DisasmRecord> instructions; // Every instruction reachable from an entry point, by address
+    std::vector<FlowBlock> blocks;          // By start address
+    std::vector<Xref> xrefs;                // Branches, jumps and calls, by target then source
+    std::map<uint16_t, Label> labels;       // Entry points and targets of xrefs
+    std::vector<uint16_t> indirect_jumps;   // JMP (ind) instructions, whose targets are not followed
+    std::vector<Xref> bad_targets;          // Control reaching bytes that are outside the image or not an instruction
+
+    // Returns nullptr unless an instruction starts at address
+    const DisasmRecord *instruction_at(uint16_t address) const;
+
+    // Xrefs whose target is address
+    std::pair<std::vector<Xref>::const_iterator, std::vector<Xref>::const_iterator> refs_to(uint16_t address) const;
+
+    // Prints a listing of the image with labels, showing bytes that are never reached as data
+    void print(std::ostream &out, const FlowImage &image) const;
+};
+
+// Recursive-descent disassembler, following branches, jumps and calls from the entry points
+// rather than decoding linearly, so data between routines is not misread as code
+//
+// Every subroutine (entry point or JSR target) is traced as its own task on a thread pool,
+// with addresses claimed atomically so no instruction is decoded twice,
+// and the results are merged and sorted afterwards, so they do not depend on the number of threads
+class FlowAnalyzer {
+ public:
+    explicit FlowAnalyzer(size_t threads=std::thread::hardware_concurrency());
+
+    FlowGraph analyze(const FlowImage &image);
+
+    // Analyzes several images at once, so small images still keep every thread busy
+    // Results are in the same order as images
+    std::vector<FlowGraph> analyze(const std::vector<FlowImage> &images);
+
+    size_t threads() const { return pool.size(); }
+
+ private:
+    ThreadPool pool;
+
+    struct Analysis;
+    void trace_routine(Analysis &analysis, uint16_t entry, size_t worker);
+    void spawn(Analysis &analysis, uint16_t entry);
+    static void merge(Analysis &analysis, FlowGraph &graph);
+};
+
+#endif // FLOW_ANALYZER_H
@@ -0,0 +1,37 @@
+#ifndef FRAMEBUFFER_RENDERER_H
+#define FRAMEBUFFER_RENDERER_H
+
+#include <array>
+#include <cstdint>
+#include <SFML/Graphics.hpp>
+
+// Draws the 32x32 palette-indexed framebuffer at 0x200-0x5FF with a single textured quad
+// The framebuffer is compared a page (8 rows) at a time against what was last uploaded,
+// and only the pages that changed are converted and sent to the texture
+class FramebufferRenderer {
+ public:
+    static const uint16_t base = 0x200;
+    static const int width = 32;
+    static const int height = 32;
+    static const size_t size = width * height;
+
+    // scale is the size of a framebuffer pixel on screen
+    explicit FramebufferRenderer(float scale=10);
+
+    // Uploads the pages of framebuffer (size bytes, colour index in the low nibble) that changed
+    // Returns whether anything was uploaded
+    bool update(const uint8_t *framebuffer);
+
+    void draw(sf::RenderTarget &target) const;
+
+ private:
+    static const int rows_per_page = 0x100 / width;
+    static const std::array<sf::Color, 16> palette;
+
+    sf::Texture texture;
+    sf::Sprite sprite;
+    std::array<uint8_t, size> shown;         // Framebuffer as last uploaded
+    std::array<sf::Uint8, size * 4> pixels;  // RGBA
+};
+
+#endif // FRAMEBUFFER_RENDERER_H
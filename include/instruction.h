@@ -1,40 +1,186 @@
 #ifndef INSTRUCTION_H
 #define INSTRUCTION_H
 
-#include <string>
-#include <memory>
-#include <unordered_map>
-#include <vector>
-
-// Functional data for an addressing mode
-typedef struct AddrMode {
-    short length; // Number of bytes, not including opcode
-    const std::string format; // A specially formatted string for (dis)assembly
-} AddrMode;
-
-// Functional information for an instruction
-typedef struct InstrMode {
-    uint8_t opcode;
-    std::string mode_str;
-    int cycles;
-} InstrMode;
-
-// Identifying information for an instruction
+#include <array>
+#include <cstdint>
+
+// Instructions, ILLEGAL for opcodes that have none
+enum class Op : uint8_t {
+    ADC, AND, ASL, BCC, BCS, BEQ, BIT, BMI, BNE, BPL, BRK, BVC, BVS, CLC, CLD, CLI, CLV, CMP, CPX, CPY,
+    DEC, DEX, DEY, EOR, INC, INX, INY, JMP, JSR, LDA, LDX, LDY, LSR, NOP, ORA, PHA, PHP, PLA, PLP,
+    ROL, ROR, RTI, RTS, SBC, SEC, SED, SEI, STA, STX, STY, TAX, TAY, TSX, TXA, TXS, TYA, ILLEGAL
+};
+
+// Addressing modes
+enum class Mode : uint8_t {
+    IMP, // Implied, no operand
+    ACC, // Accumulator
+    IMM, // Immediate
+    ZER, // Zero page
+    ZEX, // Zero page, X-indexed
+    ZEY, // Zero page, Y-indexed
+    ABS, // Absolute
+    ABX, // Absolute, X-indexed
+    ABY, // Absolute, Y-indexed
+    INX, // Indirect, X-indexed
+    INY, // Indirect, Y-indexed
+    REL, // Relative
+    ABI  // Absolute indirect
+};
+
+// Everything known about an opcode
 typedef struct InstrInfo {
-    std::string op_str;
-    std::string mode_str;
-    int cycles;
+    Op op;
+    Mode mode;
+    uint8_t length; // Operand bytes, not including the opcode
+    uint8_t cycles; // Base cycle count, before page crossings and taken branches
 } InstrInfo;
 
+// The documented opcodes, which Instructions generates its tables from
+// Kept out of Instructions, since its constexpr members can only call functions of a complete class
+class OpcodeList {
+ public:
+    static constexpr uint8_t mode_length(Mode mode) {
+        switch (mode) {
+            case Mode::IMP: case Mode::ACC: return 0;
+            case Mode::ABS: case Mode::ABX: case Mode::ABY: case Mode::ABI: return 2;
+            default: return 1;
+        }
+    }
+
+    static constexpr std::array<InstrInfo, 0x100> generate_info() {
+        std::array<InstrInfo, 0x100> table{};
+        for (auto &entry : table) entry = { Op::ILLEGAL, Mode::IMP, 0, 0 };
+        for (const auto &opcode : opcodes) {
+            table[opcode.opcode] = { opcode.op, opcode.mode, mode_length(opcode.mode), opcode.cycles };
+        }
+        return table;
+    }
+
+    template <uint8_t InstrInfo::*field>
+    static constexpr std::array<uint8_t, 0x100> generate_column() {
+        std::array<InstrInfo, 0x100> info = generate_info();
+        std::array<uint8_t, 0x100> table{};
+        for (int opcode = 0; opcode < 0x100; opcode++) table[opcode] = info[opcode].*field;
+        return table;
+    }
+
+ private:
+    typedef struct Opcode {
+        uint8_t opcode;
+        Op op;
+        Mode mode;
+        uint8_t cycles;
+    } Opcode;
+
+    static constexpr Opcode opcodes[] = {
+        {0x69, Op::ADC, Mode::IMM, 2}, {0x65, Op::ADC, Mode::ZER, 3}, {0x75, Op::ADC, Mode::ZEX, 4}, {0x6D, Op::ADC, Mode::ABS, 4},
+        {0x7D, Op::ADC, Mode::ABX, 4}, {0x79, Op::ADC, Mode::ABY, 4}, {0x61, Op::ADC, Mode::INX, 6}, {0x71, Op::ADC, Mode::INY, 5},
+        {0x29, Op::AND, Mode::IMM, 2}, {0x25, Op::AND, Mode::ZER, 3}, {0x35, Op::AND, Mode::ZEX, 4}, {0x2D, Op::AND, Mode::ABS, 4},
+        {0x3D, Op::AND, Mode::ABX, 4}, {0x39, Op::AND, Mode::ABY, 4}, {0x21, Op::AND, Mode::INX, 6}, {0x31, Op::AND, Mode::INY, 5},
+        {0x0A, Op::ASL, Mode::ACC, 2}, {0x06, Op::ASL, Mode::ZER, 5}, {0x16, Op::ASL, Mode::ZEX, 6},
+        {0x0E, Op::ASL, Mode::ABS, 6}, {0x1E, Op::ASL, Mode::ABX, 7},
+        {0x90, Op::BCC, Mode::REL, 2},
+        {0xB0, Op::BCS, Mode::REL, 2},
+        {0xF0, Op::BEQ, Mode::REL, 2},
+        {0x24, Op::BIT, Mode::ZER, 3}, {0x2C, Op::BIT, Mode::ABS, 4},
+        {0x30, Op::BMI, Mode::REL, 2},
+        {0xD0, Op::BNE, Mode::REL, 2},
+        {0x10, Op::BPL, Mode::REL, 2},
+        {0x00, Op::BRK, Mode::IMP, 7},
+        {0x50, Op::BVC, Mode::REL, 2},
+        {0x70, Op::BVS, Mode::REL, 2},
+        {0x18, Op::CLC, Mode::IMP, 2},
+        {0xD8, Op::CLD, Mode::IMP, 2},
+        {0x58, Op::CLI, Mode::IMP, 2},
+        {0xB8, Op::CLV, Mode::IMP, 2},
+        {0xC9, Op::CMP, Mode::IMM, 2}, {0xC5, Op::CMP, Mode::ZER, 3}, {0xD5, Op::CMP, Mode::ZEX, 4}, {0xCD, Op::CMP, Mode::ABS, 4},
+        {0xDD, Op::CMP, Mode::ABX, 4}, {0xD9, Op::CMP, Mode::ABY, 4}, {0xC1, Op::CMP, Mode::INX, 6}, {0xD1, Op::CMP, Mode::INY, 5},
+        {0xE0, Op::CPX, Mode::IMM, 2}, {0xE4, Op::CPX, Mode::ZER, 3}, {0xEC, Op::CPX, Mode::ABS, 4},
+        {0xC0, Op::CPY, Mode::IMM, 2}, {0xC4, Op::CPY, Mode::ZER, 3}, {0xCC, Op::CPY, Mode::ABS, 4},
+        {0xC6, Op::DEC, Mode::ZER, 5}, {0xD6, Op::DEC, Mode::ZEX, 6}, {0xCE, Op::DEC, Mode::ABS, 6}, {0xDE, Op::DEC, Mode::ABX, 7},
+        {0xCA, Op::DEX, Mode::IMP, 2},
+        {0x88, Op::DEY, Mode::IMP, 2},
+        {0x49, Op::EOR, Mode::IMM, 2}, {0x45, Op::EOR, Mode::ZER, 3}, {0x55, Op::EOR, Mode::ZEX, 4}, {0x4D, Op::EOR, Mode::ABS, 4},
+        {0x5D, Op::EOR, Mode::ABX, 4}, {0x59, Op::EOR, Mode::ABY, 4}, {0x41, Op::EOR, Mode::INX, 6}, {0x51, Op::EOR, Mode::INY, 5},
+        {0xE6, Op::INC, Mode::ZER, 5}, {0xF6, Op::INC, Mode::ZEX, 6}, {0xEE, Op::INC, Mode::ABS, 6}, {0xFE, Op::INC, Mode::ABX, 7},
+        {0xE8, Op::INX, Mode::IMP, 2},
+        {0xC8, Op::INY, Mode::IMP, 2},
+        {0x4C, Op::JMP, Mode::ABS, 3}, {0x6C, Op::JMP, Mode::ABI, 5},
+        {0x20, Op::JSR, Mode::ABS, 6},
+        {0xA9, Op::LDA, Mode::IMM, 2}, {0xA5, Op::LDA, Mode::ZER, 3}, {0xB5, Op::LDA, Mode::ZEX, 4}, {0xAD, Op::LDA, Mode::ABS, 4},
+        {0xBD, Op::LDA, Mode::ABX, 4}, {0xB9, Op::LDA, Mode::ABY, 4}, {0xA1, Op::LDA, Mode::INX, 6}, {0xB1, Op::LDA, Mode::INY, 5},
+        {0xA2, Op::LDX, Mode::IMM, 2}, {0xA6, Op::LDX, Mode::ZER, 3}, {0xB6, Op::LDX, Mode::ZEY, 4},
+        {0xAE, Op::LDX, Mode::ABS, 4}, {0xBE, Op::LDX, Mode::ABY, 4},
+        {0xA0, Op::LDY, Mode::IMM, 2}, {0xA4, Op::LDY, Mode::ZER, 3}, {0xB4, Op::LDY, Mode::ZEX, 4},
+        {0xAC, Op::LDY, Mode::ABS, 4}, {0xBC, Op::LDY, Mode::ABX, 4},
+        {0x4A, Op::LSR, Mode::ACC, 2}, {0x46, Op::LSR, Mode::ZER, 5}, {0x56, Op::LSR, Mode::ZEX, 6},
+        {0x4E, Op::LSR, Mode::ABS, 6}, {0x5E, Op::LSR, Mode::ABX, 7},
+        {0xEA, Op::NOP, Mode::IMP, 2},
+        {0x09, Op::ORA, Mode::IMM, 2}, {0x05, Op::ORA, Mode::ZER, 3}, {0x15, Op::ORA, Mode::ZEX, 4}, {0x0D, Op::ORA, Mode::ABS, 4},
+        {0x1D, Op::ORA, Mode::ABX, 4}, {0x19, Op::ORA, Mode::ABY, 4}, {0x01, Op::ORA, Mode::INX, 6}, {0x11, Op::ORA, Mode::INY, 5},
+        {0x48, Op::PHA, Mode::IMP, 3},
+        {0x08, Op::PHP, Mode::IMP, 3},
+        {0x68, Op::PLA, Mode::IMP, 4},
+        {0x28, Op::PLP, Mode::IMP, 4},
+        {0x2A, Op::ROL, Mode::ACC, 2}, {0x26, Op::ROL, Mode::ZER, 5}, {0x36, Op::ROL, Mode::ZEX, 6},
+        {0x2E, Op::ROL, Mode::ABS, 6}, {0x3E, Op::ROL, Mode::ABX, 7},
+        {0x6A, Op::ROR, Mode::ACC, 2}, {0x66, Op::ROR, Mode::ZER, 5}, {0x76, Op::ROR, Mode::ZEX, 6},
+        {0x6E, Op::ROR, Mode::ABS, 6}, {0x7E, Op::ROR, Mode::ABX, 7},
+        {0x40, Op::RTI, Mode::IMP, 6},
+        {0x60, Op::RTS, Mode::IMP, 6},
+        {0xE9, Op::SBC, Mode::IMM, 2}, {0xE5, Op::SBC, Mode::ZER, 3}, {0xF5, Op::SBC, Mode::ZEX, 4}, {0xED, Op::SBC, Mode::ABS, 4},
+        {0xFD, Op::SBC, Mode::ABX, 4}, {0xF9, Op::SBC, Mode::ABY, 4}, {0xE1, Op::SBC, Mode::INX, 6}, {0xF1, Op::SBC, Mode::INY, 5},
+        {0x38, Op::SEC, Mode::IMP, 2},
+        {0xF8, Op::SED, Mode::IMP, 2},
+        {0x78, Op::SEI, Mode::IMP, 2},
+        {0x85, Op::STA, Mode::ZER, 3}, {0x95, Op::STA, Mode::ZEX, 4}, {0x8D, Op::STA, Mode::ABS, 4}, {0x9D, Op::STA, Mode::ABX, 5},
+        {0x99, Op::STA, Mode::ABY, 5}, {0x81, Op::STA, Mode::INX, 6}, {0x91, Op::STA, Mode::INY, 6},
+        {0x86, Op::STX, Mode::ZER, 3}, {0x96, Op::STX, Mode::ZEY, 4}, {0x8E, Op::STX, Mode::ABS, 4},
+        {0x84, Op::STY, Mode::ZER, 3}, {0x94, Op::STY, Mode::ZEX, 4}, {0x8C, Op::STY, Mode::ABS, 4},
+        {0xAA, Op::TAX, Mode::IMP, 2},
+        {0xA8, Op::TAY, Mode::IMP, 2},
+        {0xBA, Op::TSX, Mode::IMP, 2},
+        {0x8A, Op::TXA, Mode::IMP, 2},
+        {0x9A, Op::TXS, Mode::IMP, 2},
+        {0x98, Op::TYA, Mode::IMP, 2}
+    };
+};
+
+// Opcode metadata, all of it built by the compiler, so it can be used in constant expressions
+// Names are only there for formatting, lookups go through the tables indexed by opcode
 class Instructions {
  public:
-    using instr_map_t = std::unordered_map<uint8_t, InstrInfo>;
-    static const instr_map_t instr_map; // Opcode uint8_t => Strings for op and mode
-    static const std::unordered_map<std::string, AddrMode> mode_map; // mode_str => mode data
+    // By opcode, with Op::ILLEGAL for undefined opcodes
+    static constexpr std::array<InstrInfo, 0x100> info = OpcodeList::generate_info();
+    // Columns of info by opcode, base cycle counts and operand bytes
+    static constexpr std::array<uint8_t, 0x100> cycle_table = OpcodeList::generate_column<&InstrInfo::cycles>();
+    static constexpr std::array<uint8_t, 0x100> length_table = OpcodeList::generate_column<&InstrInfo::length>();
+
+    static constexpr bool is_legal(uint8_t opcode) { return info[opcode].op != Op::ILLEGAL; }
+
+    static constexpr const char *op_name(Op op) { return op_names[(int) op]; }
+    static constexpr const char *mode_name(Mode mode) { return mode_names[(int) mode]; }
+
+    // A specially formatted string for (dis)assembly, with b standing for a byte operand and w for a word
+    static constexpr const char *mode_format(Mode mode) { return mode_formats[(int) mode]; }
+
+    static constexpr uint8_t mode_length(Mode mode) { return OpcodeList::mode_length(mode); }
 
  private:
-    static void add_instr(instr_map_t &map, std::string op_str, std::vector<InstrMode> modes);
-    static instr_map_t generate_instr_map();
+    static constexpr const char *op_names[] = {
+        "ADC", "AND", "ASL", "BCC", "BCS", "BEQ", "BIT", "BMI", "BNE", "BPL", "BRK", "BVC", "BVS", "CLC", "CLD", "CLI", "CLV", "CMP", "CPX", "CPY",
+        "DEC", "DEX", "DEY", "EOR", "INC", "INX", "INY", "JMP", "JSR", "LDA", "LDX", "LDY", "LSR", "NOP", "ORA", "PHA", "PHP", "PLA", "PLP",
+        "ROL", "ROR", "RTI", "RTS", "SBC", "SEC", "SED", "SEI", "STA", "STX", "STY", "TAX", "TAY", "TSX", "TXA", "TXS", "TYA", "???"
+    };
+    static constexpr const char *mode_names[] = {
+        "IMP", "ACC", "IMM", "ZER", "ZEX", "ZEY", "ABS", "ABX", "ABY", "INX", "INY", "REL", "ABI"
+    };
+    static constexpr const char *mode_formats[] = {
+        "", "A", "#$b", "$b", "$b,X", "$b,Y", "$w", "$w,X", "$w,Y", "($b,X)", "($b),Y", "$w", "($w)"
+    };
 };
 
+static_assert(Instructions::info[0xEA].op == Op::NOP && Instructions::length_table[0x6C] == 2, "Opcode table is malformed");
+
 #endif // INSTRUCTION_H
@@ -0,0 +1,78 @@
+#ifndef JIT_X64_H
+#define JIT_X64_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "memory.h"
+
+// CPU state handed to translated code, which updates it in place
+typedef struct JitState {
+    uint8_t A, X, Y, P, S;
+    uint16_t PC;
+    uint64_t budget;         // Translated loops only start another pass if it can finish within this
+    uint64_t cycles;         // Cycles used, set on return
+    const PageTable *pages;
+    uint8_t *code_map;       // 64 KiB, non-zero for addresses holding translated instructions
+    uint32_t stop_pc;        // Blocks translated now end before this address, above $FFFF for none
+} JitState;
+
+// Dynamic recompiler from 6502 code to x86-64 code, for Linux on x86-64
+// Only available when the library is compiled with CPU6502_JIT
+//
+// A block is a straight-line run of instructions from a single page, up to and including
+// the first branch, JMP, JSR or RTS. Blocks are translated once they have been entered often enough,
+// and a block that branches back to its own start loops natively while the budget allows
+// Translated code keeps A, X, Y and P in host registers, and only computes the flags that
+// a later instruction, or a return to the interpreter, can observe
+//
+// Translated code returns to the interpreter before any instruction that would
+// access an address without a direct pointer in the page table (I/O, or writes to ROM),
+// or store to an address in code_map, so the CPU can invalidate what it overwrites
+// It is never entered with the D flag set, and blocks stop short of
+// BRK, RTI, PLP, SED, CLD, JMP (ind) and illegal opcodes, so those are always interpreted
+class JitX64 {
+ public:
+    explicit JitX64(size_t code_size=16 << 20);
+    ~JitX64();
+    JitX64(const JitX64&) = delete;
+    JitX64 &operator=(const JitX64&) = delete;
+
+    // Runs translated code for state.PC, translating it first if it has become hot
+    // Returns false, leaving state untouched, if the interpreter has to execute the next instruction
+    // Marks the instructions it translates in state.code_map
+    bool execute(JitState &state);
+
+    // Drops the translations of blocks starting in page
+    void invalidate_page(uint8_t page);
+
+    // Drops every translation
+    void flush();
+
+ private:
+    using block_fn_t = void (*)(JitState *state);
+
+    typedef struct Entry {
+        block_fn_t code = nullptr;
+        uint32_t worst_cycles = 0; // Most cycles a single pass through the block can take
+        uint16_t hits = 0;
+        bool failed = false;       // The first instruction cannot be translated
+    } Entry;
+
+    using EntryPage = std::array<Entry, 0x100>; // By low byte of start address
+    std::array<std::unique_ptr<EntryPage>, 0x100> entries;
+
+    uint8_t *code_buffer; // Executable memory, only writable while translating
+    size_t code_size;
+    size_t code_used = 0;
+
+    static const int hot_threshold = 16;
+    static const size_t max_block_length = 64;      // Instructions
+    static const size_t max_code_length = 64 << 10; // Bytes of translated code for a single block
+
+    bool translate(const JitState &state, Entry &entry);
+};
+
+#endif // JIT_X64_H
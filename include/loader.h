@@ -0,0 +1,69 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "memory.h"
+
+// Bytes to be placed at address onwards
+typedef struct ImageSegment {
+    uint16_t address;
+    const uint8_t *data; // Owned by the ProgramImage, or by the caller's buffer when parsed from memory
+    size_t size;
+} ImageSegment;
+
+enum class ImageFormat {
+    RAW,       // Bytes to load at a given address
+    PRG,       // 2-byte little-endian load address, then the bytes
+    INTEL_HEX, // Intel HEX records, with 16-bit addresses
+    SEGMENTED, // Atari binary layout: $FFFF, then segments of start and end address (inclusive) and data
+    ASSEMBLY   // Source for the Assembler, with the raw address as its origin
+};
+
+// A program split into the regions it loads into, ready to be copied into a Memory
+class ProgramImage {
+ public:
+    std::vector<ImageSegment> segments;
+    std::optional<uint16_t> entry; // Written to the reset vector, unless a segment already covers it
+
+    // Copies every segment in bulk, in order, then sets the reset vector
+    void load_into(Memory &mem) const;
+
+    // Total bytes over all segments
+    size_t size() const;
+
+ private:
+    friend class Loader;
+    friend class Assembler;
+    std::shared_ptr<const void> storage; // Keeps the file mapping or decoded bytes alive
+};
+
+// Reads program images, mapping the file once and loading straight from the mapping
+// Throws std::runtime_error for files that cannot be read or are malformed,
+// and std::invalid_argument for segments that do not fit in the 64 KiB address space
+class Loader {
+ public:
+    // Picks the format from the extension: .prg, .hex or .ihx, .xex or .seg, .asm or .s, and raw otherwise
+    static ProgramImage load(const std::string &path, uint16_t raw_address=0x600);
+    static ProgramImage load(const std::string &path, ImageFormat format, uint16_t raw_address=0x600);
+
+    // Parses an image already in memory, whose segments then point into data, so it must outlive them
+    // Intel HEX and assembly are the exceptions, being decoded into storage owned by the image
+    static ProgramImage parse(const uint8_t *data, size_t size, ImageFormat format, uint16_t raw_address=0x600);
+
+    static ImageFormat format_for(const std::string &path);
+
+ private:
+    static void parse_raw(const uint8_t *data, size_t size, uint16_t address, ProgramImage &image);
+    static void parse_prg(const uint8_t *data, size_t size, ProgramImage &image);
+    static void parse_hex(const uint8_t *data, size_t size, ProgramImage &image);
+    static void parse_segmented(const uint8_t *data, size_t size, ProgramImage &image);
+    static void add_segment(ProgramImage &image, uint32_t address, const uint8_t *data, size_t size);
+};
+
+#endif // LOADER_H
@@ -0,0 +1,25 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file, unmapped on destruction
+// Throws std::runtime_error if the file cannot be opened or mapped
+class MappedFile {
+ public:
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile &operator=(const MappedFile&) = delete;
+
+    const uint8_t *data() const { return bytes; }
+    size_t size() const { return length; }
+
+ private:
+    const uint8_t *bytes = nullptr; // nullptr for an empty file
+    size_t length = 0;
+};
+
+#endif // MAPPED_FILE_H
@@ -7,17 +7,60 @@
 #include <iomanip>
 #include <fstream>
 
+// The plain memory of a page that holds memory-mapped I/O at some of its addresses
+typedef struct MixedPage {
+    uint8_t *read;
+    uint8_t *write;                // Null while writes to the page have to go through write_byte
+    std::array<uint8_t, 0x100> io; // Non-zero for the addresses that always go through read_byte/write_byte
+} MixedPage;
+
+// Direct host pointers to the 256-byte pages of the address space, indexed by addr >> 8
+// A null entry means that page has to be accessed through read_byte/write_byte,
+// e.g. because it holds memory-mapped I/O, or is ROM in the case of write
+// Pages holding I/O may also have an io entry, through which the rest of their addresses
+// are still accessed directly, so only accesses to those pages pay for checking the flags
+typedef struct PageTable {
+    std::array<uint8_t*, 0x100> read;
+    std::array<uint8_t*, 0x100> write;
+    std::array<const MixedPage*, 0x100> io;
+
+    // Direct pointers to the page of addr, or null if addr has to go through read_byte/write_byte
+    inline const uint8_t *read_page(uint16_t addr) const {
+        const uint8_t *page = read[addr >> 8];
+        if (page) return page;
+        const MixedPage *mixed = io[addr >> 8];
+        return (mixed && !mixed->io[addr & 0xFF]) ? mixed->read : nullptr;
+    }
+
+    inline uint8_t *write_page(uint16_t addr) const {
+        uint8_t *page = write[addr >> 8];
+        if (page) return page;
+        const MixedPage *mixed = io[addr >> 8];
+        return (mixed && !mixed->io[addr & 0xFF]) ? mixed->write : nullptr;
+    }
+} PageTable;
+
 class Memory {
  public:
+    virtual ~Memory() = default;
+
     virtual void write_byte(uint16_t addr, uint8_t data) = 0;
     virtual void write_word(uint16_t addr, uint16_t data) = 0;
     virtual uint8_t read_byte(uint16_t addr) = 0;
     virtual uint16_t read_word(uint16_t addr) = 0;
-    virtual uint8_t &ref_byte(uint16_t addr) = 0;
-    // If addr is in memory, this tells memory that a write has been done
-    virtual void ref_callback(uint16_t addr) = 0;
     virtual void load_file(std::ifstream &file, std::istream::pos_type in_start, std::istream::pos_type in_end, uint16_t mem_start) = 0;
+
+    // Copies length bytes to addr onwards, stopping at the end of the address space
+    // Implementations with a backing store should copy in bulk rather than a byte at a time
+    virtual void load(uint16_t addr, const uint8_t *data, size_t length) {
+        for (size_t i = 0; i < length && addr + i < 0x10000; i++) write_byte(addr + i, data[i]);
+    }
     virtual void print() = 0;
+
+    // Lets the CPU bypass read_byte/write_byte for plain memory pages
+    // The table must stay valid for the lifetime of the Memory, but its entries may change
+    // Implementations without direct pages return nullptr
+    virtual const PageTable *page_table() { return nullptr; }
 };
 
 #endif // MEMORY_H
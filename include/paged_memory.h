@@ -0,0 +1,127 @@
+#ifndef PAGED_MEMORY_H
+#define PAGED_MEMORY_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "memory.h"
+
+// 64 KiB address space split into 256-byte pages
+// RAM and ROM pages are served straight from the page table, and so are pages holding
+// memory-mapped I/O, except for their mapped addresses, which go through per-address handlers
+//
+// Pages are copy-on-write: the contents live in an immutable base image that
+// can be shared with snapshots and other PagedMemory instances, plus private
+// copies of just the pages written since that image was taken
+class PagedMemory : public Memory {
+ public:
+    using read_handler_t = std::function<uint8_t(uint16_t addr)>;
+    using write_handler_t = std::function<void(uint16_t addr, uint8_t data)>;
+
+    class Snapshot;
+
+    // Starts out as 64 KiB of zeroed RAM
+    PagedMemory();
+
+    // Forks from a snapshot, sharing all its pages until they are written
+    explicit PagedMemory(const Snapshot &snapshot);
+    PagedMemory(const PagedMemory&) = delete;
+    PagedMemory &operator=(const PagedMemory&) = delete;
+
+    virtual inline void write_byte(uint16_t addr, uint8_t data) final {
+        uint8_t *page = pages.write[addr >> 8];
+        if (page) page[addr & 0xFF] = data;
+        else write_slow(addr, data);
+    }
+
+    virtual inline void write_word(uint16_t addr, uint16_t data) final {
+        write_byte(addr, data & 0x00FF);
+        write_byte(addr+1, (data & 0xFF00) >> 8);
+    }
+
+    virtual inline uint8_t read_byte(uint16_t addr) final {
+        const uint8_t *page = pages.read[addr >> 8];
+        return page ? page[addr & 0xFF] : read_slow(addr);
+    }
+
+    virtual inline uint16_t read_word(uint16_t addr) final {
+        return read_byte(addr) + (read_byte(addr+1) << 8);
+    }
+
+    virtual const PageTable *page_table() final { return &pages; }
+
+    // Copies straight into the backing store, ignoring ROM protection and I/O handlers
+    virtual void load_file(std::ifstream &file, std::istream::pos_type in_start, std::istream::pos_type in_end, uint16_t mem_start) final;
+    virtual void load(uint16_t addr, const uint8_t *data, size_t length) final;
+    virtual void print() final;
+
+    // Each of these affects count pages, starting with first_page
+    void map_ram(uint8_t first_page, int count=1);
+    void map_rom(uint8_t first_page, int count=1); // Writes are ignored
+
+    // Routes accesses to addr through handlers, turning its page into an I/O page
+    // A null handler leaves that direction backed by plain memory,
+    // as are the addresses in an I/O page that have no handlers, which are still accessed directly
+    void map_io(uint16_t addr, read_handler_t read, write_handler_t write=nullptr);
+
+    // Captures contents, page types and I/O handlers
+    // Only the pages written since the last snapshot or restore are handed over,
+    // without copying, and the next write to any page makes a private copy of it
+    Snapshot snapshot();
+
+    // Rewinds to a snapshot without copying any pages
+    // Rewinding to the most recent snapshot only touches the pages written since
+    void restore(const Snapshot &snapshot);
+
+ private:
+    enum class PageType { RAM, ROM, IO };
+
+    typedef struct IOPort {
+        read_handler_t read;
+        write_handler_t write;
+    } IOPort;
+
+    using Page = std::array<uint8_t, 0x100>;
+
+    typedef struct IOPage {
+        std::array<uint8_t, 0x100> mapped; // Non-zero for the addresses with a handler
+        std::array<IOPort, 0x100> ports;
+    } IOPage;
+
+    // Immutable once built, so it can be shared between threads
+    typedef struct Image {
+        std::array<std::shared_ptr<const Page>, 0x100> pages;
+        std::array<PageType, 0x100> types;
+        std::array<std::shared_ptr<const IOPage>, 0x100> io_pages;
+    } Image;
+
+    PageTable pages;
+    std::array<PageType, 0x100> types;
+    std::array<std::shared_ptr<const IOPage>, 0x100> io_pages; // Only allocated for I/O pages
+    std::array<std::unique_ptr<MixedPage>, 0x100> mixed;         // Page table entries of the I/O pages
+    std::shared_ptr<const Image> base;
+    std::array<std::unique_ptr<Page>, 0x100> dirty; // Private copies of pages written since base
+    std::vector<uint8_t> written;                    // Indices of the dirty pages
+    bool remapped = false;                           // Page types or I/O handlers changed since base
+
+    void set_page(uint8_t page, PageType type);
+    void update_page(uint8_t page);
+    Page &own_page(uint8_t page);
+
+    uint8_t read_slow(uint16_t addr);
+    void write_slow(uint16_t addr, uint8_t data);
+};
+
+// Point-in-time copy of a PagedMemory, cheap to take and to restore
+// Snapshots are immutable, and can be restored or forked from on any thread
+class PagedMemory::Snapshot {
+ private:
+    friend class PagedMemory;
+
+    std::shared_ptr<const Image> image;
+
+    explicit Snapshot(std::shared_ptr<const Image> image) : image{std::move(image)} {}
+};
+
+#endif // PAGED_MEMORY_H
@@ -0,0 +1,102 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Profiling is compiled in only when CPU6502_PROFILE is defined
+// Otherwise the CPU never touches a Profiler, so profiling costs nothing
+
+// Totals for the instructions executed at one address, or with one opcode
+typedef struct ProfileCounters {
+    uint64_t count;
+    uint64_t cycles;
+    uint64_t extra_cycles; // Cycles above the base count, from page crossings and taken branches
+} ProfileCounters;
+
+// Totals for one address, with the instruction last executed there for the report
+typedef struct PCProfile {
+    ProfileCounters counters;
+    uint16_t operand;
+    uint8_t opcode;
+} PCProfile;
+
+// One call stack in the call tree, from the root down to a subroutine entry
+typedef struct CallNode {
+    uint16_t address;   // Entry point, the JSR target or the interrupt vector's target
+    uint32_t parent;    // Index of the caller's node, the root is its own parent
+    uint64_t calls;
+    uint64_t self_cycles; // Cycles spent in this stack and not in a deeper one
+} CallNode;
+
+// Flat per-PC and per-opcode counters, and a call tree built from JSR/RTS and interrupts
+// Recording an instruction is a few array increments, plus a lookup on calls and returns
+class Profiler {
+ public:
+    Profiler();
+
+    // Called by the CPU after executing an instruction at pc, cycles including extra_cycles
+    inline void record(uint16_t pc, uint8_t opcode, uint16_t operand, int cycles, int extra_cycles) {
+        PCProfile &at = (*pcs)[pc];
+        at.counters.count++;
+        at.counters.cycles += cycles;
+        at.counters.extra_cycles += extra_cycles;
+        at.operand = operand;
+        at.opcode = opcode;
+
+        ProfileCounters &of = opcodes[opcode];
+        of.count++;
+        of.cycles += cycles;
+        of.extra_cycles += extra_cycles;
+
+        nodes[current].self_cycles += cycles;
+    }
+
+    // Control entered a subroutine or interrupt handler at address
+    // stack_pointer is S before the return address was pushed
+    void call(uint16_t address, uint8_t stack_pointer);
+
+    // An RTS or RTI left S at stack_pointer, returning from every call made below it
+    void ret(uint8_t stack_pointer);
+
+    // Forgets everything recorded, starting again with an empty call stack
+    void clear();
+
+    const std::array<PCProfile, 0x10000> &by_pc() const { return *pcs; }
+    const std::array<ProfileCounters, 0x100> &by_opcode() const { return opcodes; }
+
+    // Node 0 is the root, which stands for code run outside any recorded call
+    const std::vector<CallNode> &call_tree() const { return nodes; }
+
+    // Flat profile, hottest first, with each address disassembled
+    // then per-opcode totals and the call graph with self and inclusive cycles per subroutine
+    // limit caps the number of rows in each table, 0 for no cap
+    void print(std::ostream &out, size_t limit=50) const;
+
+    // One line per call stack, e.g. "root;sub_0640;sub_0700 1234", weighted by self cycles
+    // This is the folded format read by flamegraph.pl and speedscope
+    void print_folded(std::ostream &out) const;
+
+ private:
+    typedef struct Frame {
+        uint32_t node;
+        uint8_t stack_pointer;
+    } Frame;
+
+    std::unique_ptr<std::array<PCProfile, 0x10000>> pcs; // 2 MiB, so kept off the stack
+    std::array<ProfileCounters, 0x100> opcodes;
+
+    std::vector<CallNode> nodes;
+    std::unordered_map<uint64_t, uint32_t> children; // By parent node << 16 | address
+    std::vector<Frame> stack;
+    uint32_t current; // Node of the innermost call
+
+    static std::string node_name(uint16_t address);
+};
+
+#endif // PROFILER_H
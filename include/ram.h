@@ -1,6 +1,8 @@
 #ifndef RAM_H
 #define RAM_H
 
+#include <algorithm>
+
 #include "memory.h"
 
 // Basic RAM class without a bus
@@ -9,13 +11,17 @@
 template <size_t SIZE>
 class RAM : public Memory {
  public:
+    RAM() { map_pages(); }
+    RAM(const RAM &other) : mem(other.mem) { map_pages(); }
+    RAM &operator=(const RAM &other) { mem = other.mem; return *this; }
+
     virtual inline void write_byte(uint16_t addr, uint8_t data) {
         mem[addr] = data;
     }
 
     virtual inline void write_word(uint16_t addr, uint16_t data) {
         mem[addr] = data & 0x00FF;
-        mem[addr+1] = (data & 0xFF00) >> 8;
+        mem[(uint16_t) (addr+1)] = (data & 0xFF00) >> 8;
     }
 
     virtual inline uint8_t read_byte(uint16_t addr) {
@@ -23,27 +29,28 @@ class RAM : public Memory {
     }
 
     virtual inline uint16_t read_word(uint16_t addr) {
-        return mem[addr] + (mem[addr+1] << 8);
+        return mem[addr] + (mem[(uint16_t) (addr+1)] << 8);
     }
 
-    virtual inline uint8_t &ref_byte(uint16_t addr) {
-        return mem.at(addr);
+    void clear() {
+        mem.fill(0);
     }
 
-    virtual inline void ref_callback(uint16_t addr) {}
+    virtual const PageTable *page_table() {
+        return &pages;
+    }
 
+    // Reads the bytes [in_start, in_end] of file to mem_start onwards, as far as the end of mem
     virtual void load_file(std::ifstream &file, std::istream::pos_type in_start, std::istream::pos_type in_end, uint16_t mem_start) {
+        std::streamoff length = std::min<std::streamoff>(in_end - in_start + 1, (std::streamoff) SIZE - mem_start);
+        if (length <= 0) return;
         file.seekg(in_start, file.beg);
-        int head = in_start;
-        int i = mem_start;
-        char temp;
-        while (head <= in_end) {
-            file.read(&temp, 1);
-            // std::cout << temp;
-            mem[i] = (uint8_t) temp;
-            head++;
-            i++;
-        }
+        file.read(reinterpret_cast<char*>(&mem[mem_start]), length);
+    }
+
+    virtual void load(uint16_t addr, const uint8_t *data, size_t length) {
+        if (addr >= SIZE) return;
+        std::copy_n(data, std::min(length, SIZE - addr), &mem[addr]);
     }
 
     virtual void print() {
@@ -55,6 +62,17 @@ class RAM : public Memory {
 
  protected:
     std::array<uint8_t, SIZE> mem;
+    PageTable pages;
+
+    // Every page that lies wholly inside mem can be accessed directly
+    void map_pages() {
+        for (size_t page = 0; page < 0x100; page++) {
+            uint8_t *ptr = ((page+1) * 0x100 <= SIZE) ? &mem[page * 0x100] : nullptr;
+            pages.read[page] = ptr;
+            pages.write[page] = ptr;
+            pages.io[page] = nullptr;
+        }
+    }
 };
 
 template class RAM<0x100>;
@@ -0,0 +1,49 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+// Paces emulation against the host's monotonic clock
+// Each slice runs the cycles due for one time quantum in a single batch,
+// then sleeps once until the slice's deadline
+// Deadlines are absolute, so sleep overshoot is made up in later slices instead of accumulating
+class Scheduler {
+ public:
+    using clock = std::chrono::steady_clock;
+
+    // Runs the machine for up to budget cycles, returning the cycles actually run
+    using run_t = std::function<uint64_t(uint64_t budget)>;
+
+    // A clock_hz of zero or less runs unthrottled, never sleeping
+    Scheduler(double clock_hz, clock::duration quantum=std::chrono::milliseconds(10));
+
+    // Runs one slice, returning the cycles run
+    uint64_t run_slice(const run_t &run);
+
+    bool is_throttled() const { return clock_hz > 0; }
+    double target_hz() const { return clock_hz; }
+
+    // Emulated clock rate since construction or the last reset_stats()
+    double achieved_hz() const;
+    void reset_stats();
+
+ private:
+    double clock_hz;
+    clock::duration quantum;
+
+    clock::time_point start; // Time at which slice 0 began
+    uint64_t slices;         // Slices whose deadlines have been scheduled since start
+    uint64_t cycles_run;     // Cycles credited since start
+
+    clock::time_point stats_start;
+    uint64_t stats_cycles;
+
+    static constexpr uint64_t unthrottled_slice = 1 << 20; // Cycles per slice when unthrottled
+    static constexpr int max_lag = 10; // Quanta behind schedule before catching up is abandoned
+
+    void resync(clock::time_point now);
+};
+
+#endif // SCHEDULER_H
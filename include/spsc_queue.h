@@ -0,0 +1,50 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue for exactly one producer thread and one consumer thread
+// CAPACITY must be a power of two
+template <typename T, size_t CAPACITY>
+class SpscQueue {
+    static_assert(CAPACITY && !(CAPACITY & (CAPACITY - 1)), "SpscQueue capacity must be a power of two");
+
+ public:
+    // Producer: returns false, dropping value, if the queue is full
+    bool push(const T &value) {
+        size_t tail = this->tail.load(std::memory_order_relaxed);
+        if (tail - cached_head == CAPACITY) {
+            cached_head = head.load(std::memory_order_acquire);
+            if (tail - cached_head == CAPACITY) return false;
+        }
+        slots[tail & (CAPACITY - 1)] = value;
+        this->tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: returns false if the queue is empty
+    bool pop(T &value) {
+        size_t head = this->head.load(std::memory_order_relaxed);
+        if (head == cached_tail) {
+            cached_tail = tail.load(std::memory_order_acquire);
+            if (head == cached_tail) return false;
+        }
+        value = slots[head & (CAPACITY - 1)];
+        this->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+ private:
+    std::array<T, CAPACITY> slots{};
+
+    // Each side keeps its own index and a stale copy of the other's on the same cache line,
+    // so it only reads the other side's line when the queue looks full or empty
+    alignas(64) std::atomic<size_t> head{0}; // Next slot to pop
+    size_t cached_tail = 0;
+    alignas(64) std::atomic<size_t> tail{0}; // Next slot to push
+    size_t cached_head = 0;
+};
+
+#endif // SPSC_QUEUE_H
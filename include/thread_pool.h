@@ -0,0 +1,58 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads with work stealing
+// Every worker has its own queue, taking new work from the back of it,
+// and steals from the front of the others' queues once its own is empty
+class ThreadPool {
+ public:
+    // Tasks are passed the index of the worker running them, in [0, size())
+    using task_t = std::function<void(size_t worker)>;
+
+    explicit ThreadPool(size_t threads=std::thread::hardware_concurrency());
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool &operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers.size(); }
+
+    // Queues a task, spreading tasks across the workers' queues in turn
+    void submit(task_t task);
+
+    // Blocks until every submitted task has finished
+    // Rethrows the first exception thrown by a task, if any
+    void wait();
+
+ private:
+    typedef struct Worker {
+        std::deque<task_t> tasks;
+        std::mutex lock;
+    } Worker;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+
+    std::mutex state_lock;
+    std::condition_variable work_available;
+    std::condition_variable all_done;
+    std::atomic<long> queued; // Tasks waiting in any queue
+    size_t unfinished;        // Tasks submitted but not yet finished, guarded by state_lock
+    size_t next_worker;
+    bool stopping;
+    std::exception_ptr error;
+
+    void work(size_t index);
+    bool take(size_t index, task_t &task);
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,58 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Tracing is compiled in only when CPU6502_TRACE is defined
+// Otherwise the CPU never touches a TraceBuffer, so tracing costs nothing
+enum class TraceLevel {
+    OFF,          // Record nothing
+    CONTROL_FLOW, // Record only instructions that leave straight-line code
+    ALL           // Record every instruction
+};
+
+// CPU state at the start of an instruction
+// Kept fixed-size so recording is a plain store into the ring buffer
+typedef struct TraceRecord {
+    uint64_t cycle;   // Value of the cycle counter before the instruction
+    uint16_t PC;
+    uint16_t operand; // Operand bytes, little-endian, as fetched
+    uint8_t opcode;
+    uint8_t A, X, Y, P, S;
+} TraceRecord;
+
+// Preallocated ring buffer holding the most recent trace records
+class TraceBuffer {
+ public:
+    // Capacity is rounded up to a power of two
+    TraceBuffer(size_t capacity=1 << 16);
+
+    // Returns the slot for the next record, which is only kept once committed
+    inline TraceRecord &next() { return records[head & mask]; }
+    inline void commit() { head++; }
+
+    void clear() { head = 0; }
+
+    // Number of records held, up to the capacity
+    size_t size() const { return (head < records.size()) ? head : records.size(); }
+
+    // Records total, including those that have been overwritten
+    uint64_t total() const { return head; }
+
+    // i = 0 is the oldest record still held
+    const TraceRecord &operator[](size_t i) const { return records[(head - size() + i) & mask]; }
+
+    // Disassembles the held records, oldest first
+    void print(std::ostream &out) const;
+    static std::string record_to_string(const TraceRecord &record);
+
+ private:
+    std::vector<TraceRecord> records;
+    uint64_t mask;
+    uint64_t head;
+};
+
+#endif // TRACE_H
@@ -0,0 +1,44 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free triple buffer handing the latest value from one producer thread to one consumer thread
+// The producer always has a buffer to write and the consumer always has a complete one to read,
+// so neither ever waits for the other; values published in between reads are skipped
+template <typename T>
+class TripleBuffer {
+ public:
+    // Producer: fill back(), then publish() to make it the newest value
+    T &back() { return buffers[back_index]; }
+
+    void publish() {
+        back_index = middle.exchange(back_index | fresh, std::memory_order_acq_rel) & index_mask;
+    }
+
+    // Consumer: takes the newest published value, if there is one it has not seen
+    // Returns whether front() changed
+    bool update() {
+        if (!(middle.load(std::memory_order_relaxed) & fresh)) return false;
+        front_index = middle.exchange(front_index, std::memory_order_acq_rel) & index_mask;
+        return true;
+    }
+
+    const T &front() const { return buffers[front_index]; }
+
+ private:
+    static const uint8_t index_mask = 0x3;
+    static const uint8_t fresh = 0x4; // Set in middle when it holds a value the consumer has not taken
+
+    std::array<T, 3> buffers{};
+
+    // Index of the buffer between the two threads, on its own cache line so the
+    // producer's and consumer's own indices are never shared
+    alignas(64) std::atomic<uint8_t> middle{1};
+    alignas(64) uint8_t back_index = 0;  // Only touched by the producer
+    alignas(64) uint8_t front_index = 2; // Only touched by the consumer
+};
+
+#endif // TRIPLE_BUFFER_H
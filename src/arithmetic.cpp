@@ -0,0 +1,64 @@
+#include "arithmetic.h"
+
+namespace {
+
+// Flag bits, as in P
+const unsigned N = 0x80, V = 0x40, Z = 0x02, C = 0x01;
+
+uint16_t entry(unsigned result, unsigned flags) {
+    return (uint16_t) ((flags << 8) | (result & 0xFF));
+}
+
+uint16_t add_binary(unsigned a, unsigned b, unsigned carry) {
+    unsigned sum = a + b + carry;
+    unsigned flags = (sum & 0x80 ? N : 0) | (~(a ^ b) & (a ^ sum) & 0x80 ? V : 0)
+                   | ((sum & 0xFF) == 0 ? Z : 0) | (sum > 0xFF ? C : 0);
+    return entry(sum, flags);
+}
+
+// Per nibble adjustment as done by the NMOS 6502
+uint16_t add_decimal(unsigned a, unsigned b, unsigned carry) {
+    int low = (a & 0x0F) + (b & 0x0F) + carry;
+    if (low >= 0x0A) low = ((low + 0x06) & 0x0F) + 0x10;
+    int sum = (a & 0xF0) + (b & 0xF0) + low;
+
+    // N and V come from the sum before the high nibble is adjusted
+    int signed_sum = (int8_t) (a & 0xF0) + (int8_t) (b & 0xF0) + low;
+    unsigned flags = (sum & 0x80 ? N : 0) | (signed_sum < -128 || signed_sum > 127 ? V : 0)
+                   | (((a + b + carry) & 0xFF) == 0 ? Z : 0);
+
+    if (sum >= 0xA0) sum += 0x60;
+    if (sum >= 0x100) flags |= C;
+    return entry(sum, flags);
+}
+
+// Flags are those of the binary subtraction, which is an addition of the inverted operand
+uint16_t subtract_decimal(unsigned a, unsigned b, unsigned carry) {
+    int low = (int) (a & 0x0F) - (int) (b & 0x0F) + (int) carry - 1;
+    if (low < 0) low = ((low - 0x06) & 0x0F) - 0x10;
+    int difference = (int) (a & 0xF0) - (int) (b & 0xF0) + low;
+    if (difference < 0) difference -= 0x60;
+    return entry(difference, add_binary(a, b ^ 0xFF, carry) >> 8);
+}
+
+template <bool subtract>
+std::array<uint16_t, 0x40000> generate_table() {
+    std::array<uint16_t, 0x40000> table{};
+    for (unsigned decimal = 0; decimal < 2; decimal++) {
+        for (unsigned carry = 0; carry < 2; carry++) {
+            for (unsigned a = 0; a < 0x100; a++) {
+                for (unsigned b = 0; b < 0x100; b++) {
+                    uint16_t &result = table[Arithmetic::index(a, b, (decimal ? 0x08 : 0) | carry)];
+                    if (!decimal) result = add_binary(a, subtract ? b ^ 0xFF : b, carry);
+                    else result = subtract ? subtract_decimal(a, b, carry) : add_decimal(a, b, carry);
+                }
+            }
+        }
+    }
+    return table;
+}
+
+}
+
+const std::array<uint16_t, 0x40000> Arithmetic::adc_table = generate_table<false>();
+const std::array<uint16_t, 0x40000> Arithmetic::sbc_table = generate_table<true>();
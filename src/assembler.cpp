@@ -0,0 +1,473 @@
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+#include "assembler.h"
+
+namespace {
+
+typedef std::unordered_map<std::string_view, int32_t> Symbols;
+
+const size_t op_count = (size_t) Op::ILLEGAL;
+const size_t mode_count = (size_t) Mode::ABI + 1;
+
+// Op and Mode => Opcode, -1 where the instruction has no such mode
+constexpr std::array<std::array<int16_t, mode_count>, op_count> generate_opcodes() {
+    std::array<std::array<int16_t, mode_count>, op_count> table{};
+    for (auto &modes : table) {
+        for (auto &opcode : modes) opcode = -1;
+    }
+    for (int opcode = 0; opcode < 0x100; opcode++) {
+        const InstrInfo &info = Instructions::info[opcode];
+        if (info.op != Op::ILLEGAL) table[(int) info.op][(int) info.mode] = opcode;
+    }
+    return table;
+}
+
+constexpr std::array<std::array<int16_t, mode_count>, op_count> opcodes = generate_opcodes();
+
+// Mnemonics are looked up by binary search, which relies on Op being in alphabetical order
+constexpr bool ops_sorted() {
+    for (size_t i = 1; i < op_count; i++) {
+        const char *a = Instructions::op_name((Op) (i - 1)), *b = Instructions::op_name((Op) i);
+        if (a[0] > b[0] || (a[0] == b[0] && (a[1] > b[1] || (a[1] == b[1] && a[2] >= b[2])))) return false;
+    }
+    return true;
+}
+
+static_assert(ops_sorted(), "Op is not in alphabetical order");
+
+[[noreturn]] void fail(uint32_t line, const std::string &what) {
+    throw std::runtime_error("Assembly line " + std::to_string(line) + ": " + what);
+}
+
+bool is_symbol_start(char c) {
+    return std::isalpha((unsigned char) c) || c == '_';
+}
+
+bool is_symbol_char(char c) {
+    return std::isalnum((unsigned char) c) || c == '_';
+}
+
+std::string_view trim(std::string_view text) {
+    while (!text.empty() && std::isspace((unsigned char) text.front())) text.remove_prefix(1);
+    while (!text.empty() && std::isspace((unsigned char) text.back())) text.remove_suffix(1);
+    return text;
+}
+
+bool equals_ignoring_case(std::string_view text, const char *upper) {
+    size_t i = 0;
+    for (; i < text.size() && upper[i]; i++) {
+        if (std::toupper((unsigned char) text[i]) != upper[i]) return false;
+    }
+    return i == text.size() && !upper[i];
+}
+
+Op find_op(std::string_view text) {
+    if (text.size() != 3) return Op::ILLEGAL;
+    char name[3];
+    for (int i = 0; i < 3; i++) name[i] = std::toupper((unsigned char) text[i]);
+
+    size_t low = 0, high = op_count;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        int order = std::memcmp(Instructions::op_name((Op) middle), name, 3);
+        if (order == 0) return (Op) middle;
+        if (order < 0) low = middle + 1;
+        else high = middle;
+    }
+    return Op::ILLEGAL;
+}
+
+// Position of the first c in text that is not inside quotes, or npos
+size_t find_unquoted(std::string_view text, char c) {
+    char quote = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (quote) {
+            if (text[i] == quote) quote = 0;
+        }
+        else if (text[i] == '"' || text[i] == '\'') quote = text[i];
+        else if (text[i] == c) return i;
+    }
+    return std::string_view::npos;
+}
+
+// Calls f with each item of a comma-separated list, empty ones included
+template <class F>
+void for_each_item(std::string_view list, F f) {
+    while (true) {
+        size_t comma = find_unquoted(list, ',');
+        f(trim(list.substr(0, comma)));
+        if (comma == std::string_view::npos) return;
+        list = list.substr(comma + 1);
+    }
+}
+
+// Recursive descent over one expression, binary operators taking the precedence they have in C
+class Expression {
+ public:
+    Expression(std::string_view text, const Symbols &symbols, uint16_t pc, uint32_t line)
+        : text(text), symbols(symbols), pc(pc), line(line) {};
+
+    bool known = true;          // False when the expression uses a symbol not defined yet, its value is then meaningless
+    std::string_view undefined; // The first such symbol
+
+    int32_t evaluate() {
+        int32_t value = binary(0);
+        skip_space();
+        if (pos < text.size()) fail(line, "unexpected '" + std::string(1, text[pos]) + "' in expression");
+        return value;
+    }
+
+ private:
+    std::string_view text;
+    const Symbols &symbols;
+    uint16_t pc;
+    uint32_t line;
+    size_t pos = 0;
+
+    static int level_of(char c) {
+        switch (c) {
+            case '|': return 0;
+            case '^': return 1;
+            case '&': return 2;
+            case '+': case '-': return 3;
+            case '*': case '/': return 4;
+            default: return -1;
+        }
+    }
+
+    void skip_space() {
+        while (pos < text.size() && std::isspace((unsigned char) text[pos])) pos++;
+    }
+
+    // Arithmetic wraps rather than overflowing, values only matter modulo 2^16 anyway
+    int32_t binary(int level) {
+        if (level > 4) return unary();
+        int32_t value = binary(level + 1);
+        while (skip_space(), pos < text.size() && level_of(text[pos]) == level) {
+            char op = text[pos++];
+            int32_t rhs = binary(level + 1);
+            switch (op) {
+                case '|': value |= rhs; break;
+                case '^': value ^= rhs; break;
+                case '&': value &= rhs; break;
+                case '+': value = (int32_t) ((uint32_t) value + (uint32_t) rhs); break;
+                case '-': value = (int32_t) ((uint32_t) value - (uint32_t) rhs); break;
+                case '*': value = (int32_t) ((uint32_t) value * (uint32_t) rhs); break;
+                case '/':
+                    if (rhs == 0 && known) fail(line, "division by zero");
+                    // In 64 bits, since the 32-bit quotient of INT32_MIN / -1 overflows, and wrapped like the rest
+                    value = (rhs == 0) ? 0 : (int32_t) (uint32_t) ((int64_t) value / rhs);
+                    break;
+            }
+        }
+        return value;
+    }
+
+    int32_t unary() {
+        skip_space();
+        if (pos >= text.size()) fail(line, "missing value");
+        switch (text[pos]) {
+            case '-': pos++; return (int32_t) (0u - (uint32_t) unary());
+            case '<': pos++; return unary() & 0xFF;
+            case '>': pos++; return (unary() >> 8) & 0xFF;
+            default: return primary();
+        }
+    }
+
+    int32_t primary() {
+        char c = text[pos];
+        if (c == '*') {
+            pos++;
+            return pc;
+        }
+        if (c == '$') return number(16, 1);
+        if (c == '%') return number(2, 1);
+        if (std::isdigit((unsigned char) c)) return number(10, 0);
+        if (c == '\'') {
+            if (pos + 2 >= text.size() || text[pos + 2] != '\'') fail(line, "bad character constant");
+            pos += 3;
+            return (uint8_t) text[pos - 2];
+        }
+        if (is_symbol_start(c)) {
+            size_t start = pos;
+            while (pos < text.size() && is_symbol_char(text[pos])) pos++;
+            std::string_view name = text.substr(start, pos - start);
+            auto symbol = symbols.find(name);
+            if (symbol != symbols.end()) return symbol->second;
+            if (known) undefined = name;
+            known = false;
+            return 0;
+        }
+        fail(line, "unexpected '" + std::string(1, c) + "' in expression");
+    }
+
+    int32_t number(int base, size_t prefix) {
+        pos += prefix;
+        size_t start = pos;
+        int32_t value = 0;
+        for (; pos < text.size() && is_symbol_char(text[pos]); pos++) {
+            char c = std::toupper((unsigned char) text[pos]);
+            int digit = std::isdigit((unsigned char) c) ? c - '0' : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : base;
+            if (digit >= base) fail(line, "bad digit '" + std::string(1, text[pos]) + "' in number");
+            value = value * base + digit;
+            if (value > 0xFFFF) fail(line, "number does not fit in 16 bits");
+        }
+        if (pos == start) fail(line, "number has no digits");
+        return value;
+    }
+};
+
+// Addressing syntax of an operand, before zero page and absolute forms are told apart
+enum class Syntax { NONE, ACCUMULATOR, IMMEDIATE, DIRECT, DIRECT_X, DIRECT_Y, INDIRECT, INDIRECT_X, INDIRECT_Y };
+
+bool is_register(std::string_view text, char name) {
+    text = trim(text);
+    return text.size() == 1 && std::toupper((unsigned char) text[0]) == name;
+}
+
+// Splits operand into its addressing syntax and the expression it holds
+Syntax classify(std::string_view operand, std::string_view &expression, uint32_t line) {
+    if (operand.empty()) return Syntax::NONE;
+    if (is_register(operand, 'A')) return Syntax::ACCUMULATOR;
+    if (operand[0] == '#') {
+        expression = trim(operand.substr(1));
+        return Syntax::IMMEDIATE;
+    }
+    if (operand[0] == '(') {
+        if (operand.back() == ')') {
+            std::string_view inside = operand.substr(1, operand.size() - 2);
+            size_t comma = inside.find_last_of(',');
+            expression = trim(inside.substr(0, comma));
+            if (comma == std::string_view::npos) return Syntax::INDIRECT;
+            if (!is_register(inside.substr(comma + 1), 'X')) fail(line, "expected ,X) after indirect operand");
+            return Syntax::INDIRECT_X;
+        }
+        size_t close = operand.find_last_of(')');
+        std::string_view index = (close == std::string_view::npos) ? "" : trim(operand.substr(close + 1));
+        if (index.empty() || index[0] != ',' || !is_register(index.substr(1), 'Y')) fail(line, "expected ),Y after indirect operand");
+        expression = trim(operand.substr(1, close - 1));
+        return Syntax::INDIRECT_Y;
+    }
+    size_t comma = operand.find_last_of(',');
+    expression = trim(operand.substr(0, comma));
+    if (comma == std::string_view::npos) return Syntax::DIRECT;
+    if (is_register(operand.substr(comma + 1), 'X')) return Syntax::DIRECT_X;
+    if (is_register(operand.substr(comma + 1), 'Y')) return Syntax::DIRECT_Y;
+    fail(line, "bad index register");
+}
+
+// Opcode for op with the given syntax, zero page if it exists and either the operand fits a byte
+// or there is no absolute form, -1 if op has no such mode
+int choose_opcode(Op op, Syntax syntax, bool fits_byte) {
+    const auto &modes = opcodes[(int) op];
+    auto pick = [&modes, fits_byte](Mode zero_page, Mode absolute) {
+        int16_t zero = modes[(int) zero_page], full = modes[(int) absolute];
+        return (zero >= 0 && (full < 0 || fits_byte)) ? zero : full;
+    };
+    switch (syntax) {
+        case Syntax::NONE:        return (modes[(int) Mode::IMP] >= 0) ? modes[(int) Mode::IMP] : modes[(int) Mode::ACC];
+        case Syntax::ACCUMULATOR: return modes[(int) Mode::ACC];
+        case Syntax::IMMEDIATE:   return modes[(int) Mode::IMM];
+        case Syntax::DIRECT:      return (modes[(int) Mode::REL] >= 0) ? modes[(int) Mode::REL] : pick(Mode::ZER, Mode::ABS);
+        case Syntax::DIRECT_X:    return pick(Mode::ZEX, Mode::ABX);
+        case Syntax::DIRECT_Y:    return pick(Mode::ZEY, Mode::ABY);
+        case Syntax::INDIRECT:    return modes[(int) Mode::ABI];
+        case Syntax::INDIRECT_X:  return modes[(int) Mode::INX];
+        case Syntax::INDIRECT_Y:  return modes[(int) Mode::INY];
+    }
+    return -1;
+}
+
+}
+
+ProgramImage Assembler::assemble(std::string_view source) {
+    run(source);
+    auto storage = std::make_shared<std::vector<uint8_t>>(bytes);
+    ProgramImage image;
+    for (const auto &segment : program.segments) {
+        image.segments.push_back({ segment.address, storage->data() + (segment.data - bytes.data()), segment.size });
+    }
+    image.entry = program.entry;
+    image.storage = storage;
+    return image;
+}
+
+uint16_t Assembler::assemble(std::string_view source, Memory &mem) {
+    run(source);
+    program.load_into(mem);
+    return *program.entry;
+}
+
+uint16_t Assembler::assemble(std::string_view source, uint8_t *buffer, size_t size, uint16_t base) {
+    run(source);
+    for (const auto &segment : program.segments) {
+        if (segment.address < base || segment.address - base + segment.size > size) {
+            throw std::invalid_argument("Program does not fit in the buffer");
+        }
+        std::memcpy(buffer + (segment.address - base), segment.data, segment.size);
+    }
+    return *program.entry;
+}
+
+std::optional<uint16_t> Assembler::symbol(std::string_view name) const {
+    auto symbol = symbols.find(name);
+    if (symbol == symbols.end()) return std::nullopt;
+    return (uint16_t) symbol->second;
+}
+
+void Assembler::run(std::string_view source) {
+    symbols.clear();
+    statements.clear();
+    blocks.assign(1, { origin, 0 });
+    text.assign(source);
+
+    first_pass();
+    second_pass();
+
+    program.segments.clear();
+    const uint8_t *data = bytes.data();
+    for (const Block &block : blocks) {
+        if (block.size) program.segments.push_back({ block.address, data, block.size });
+        data += block.size;
+    }
+    program.entry = program.segments.empty() ? origin : program.segments[0].address;
+}
+
+void Assembler::first_pass() {
+    uint32_t pc = origin;
+    uint32_t number = 0;
+    std::string_view rest = text;
+    while (!rest.empty()) {
+        size_t end = rest.find('\n');
+        parse_line(rest.substr(0, end), ++number, pc);
+        rest = (end == std::string_view::npos) ? std::string_view() : rest.substr(end + 1);
+    }
+}
+
+void Assembler::parse_line(std::string_view line, uint32_t number, uint32_t &pc) {
+    line = trim(line.substr(0, find_unquoted(line, ';')));
+    if (line.empty()) return;
+
+    auto define = [this, number](std::string_view name, int32_t value) {
+        if (!symbols.emplace(name, value).second) fail(number, "duplicate symbol " + std::string(name));
+    };
+
+    // A label before the statement, or a constant taking the whole line
+    if (is_symbol_start(line[0])) {
+        size_t end = 1;
+        while (end < line.size() && is_symbol_char(line[end])) end++;
+        std::string_view name = line.substr(0, end), rest = trim(line.substr(end));
+        if (!rest.empty() && rest[0] == ':') {
+            define(name, pc);
+            line = trim(rest.substr(1));
+            if (line.empty()) return;
+        }
+        else if (!rest.empty() && rest[0] == '=') {
+            Expression expression(rest.substr(1), symbols, pc, number);
+            int32_t value = expression.evaluate();
+            if (!expression.known) fail(number, "constant uses " + std::string(expression.undefined) + " before it is defined");
+            define(name, value);
+            return;
+        }
+    }
+
+    size_t end = 0;
+    while (end < line.size() && !std::isspace((unsigned char) line[end])) end++;
+    std::string_view word = line.substr(0, end), operand = trim(line.substr(end));
+    Statement statement = { Kind::INSTRUCTION, 0, (uint16_t) pc, number, operand };
+    uint32_t size = 0;
+
+    if (word[0] == '.') {
+        if (equals_ignoring_case(word, ".ORG")) {
+            Expression expression(operand, symbols, pc, number);
+            int32_t address = expression.evaluate();
+            if (!expression.known) fail(number, ".org uses " + std::string(expression.undefined) + " before it is defined");
+            if (address < 0 || address > 0xFFFF) fail(number, ".org address out of range");
+            if (blocks.back().size) blocks.push_back({ (uint16_t) address, 0 });
+            else blocks.back().address = address;
+            pc = address;
+            return;
+        }
+        if (equals_ignoring_case(word, ".BYTE")) statement.kind = Kind::BYTE;
+        else if (equals_ignoring_case(word, ".WORD")) statement.kind = Kind::WORD;
+        else fail(number, "unknown directive " + std::string(word));
+
+        for_each_item(operand, [&statement, &size, number](std::string_view item) {
+            if (item.empty()) fail(number, "missing value");
+            if (item[0] != '"') size += (statement.kind == Kind::WORD) ? 2 : 1;
+            else if (statement.kind == Kind::WORD) fail(number, "strings are only allowed in .byte");
+            else if (item.size() < 2 || item.back() != '"') fail(number, "unterminated string");
+            else size += item.size() - 2;
+        });
+    }
+    else {
+        Op op = find_op(word);
+        if (op == Op::ILLEGAL) fail(number, "unknown instruction " + std::string(word));
+        Syntax syntax = classify(operand, statement.operand, number);
+        if (syntax != Syntax::NONE && syntax != Syntax::ACCUMULATOR && statement.operand.empty()) fail(number, "missing operand");
+
+        bool fits_byte = false;
+        if (syntax == Syntax::DIRECT || syntax == Syntax::DIRECT_X || syntax == Syntax::DIRECT_Y) {
+            Expression expression(statement.operand, symbols, pc, number);
+            int32_t value = expression.evaluate();
+            fits_byte = expression.known && value >= 0 && value <= 0xFF;
+        }
+        int opcode = choose_opcode(op, syntax, fits_byte);
+        if (opcode < 0) fail(number, std::string(Instructions::op_name(op)) + " has no such addressing mode");
+        statement.opcode = opcode;
+        size = 1 + Instructions::length_table[opcode];
+    }
+
+    if (pc + size > 0x10000) throw std::invalid_argument("Program does not fit in memory");
+    statements.push_back(statement);
+    blocks.back().size += size;
+    pc += size;
+}
+
+void Assembler::second_pass() {
+    bytes.clear();
+    for (const Statement &statement : statements) {
+        auto value = [this, &statement](std::string_view text, int32_t min, int32_t max) {
+            Expression expression(text, symbols, statement.address, statement.line);
+            int32_t value = expression.evaluate();
+            if (!expression.known) fail(statement.line, "undefined symbol " + std::string(expression.undefined));
+            if (value < min || value > max) fail(statement.line, "value " + std::to_string(value) + " out of range");
+            return value;
+        };
+
+        if (statement.kind == Kind::INSTRUCTION) {
+            const InstrInfo &info = Instructions::info[statement.opcode];
+            bytes.push_back(statement.opcode);
+            if (info.mode == Mode::REL) {
+                int32_t offset = value(statement.operand, 0, 0xFFFF) - (statement.address + 2);
+                if (offset < -128 || offset > 127) fail(statement.line, "branch out of range");
+                bytes.push_back(offset);
+            }
+            else if (info.length == 1) {
+                bytes.push_back(value(statement.operand, (info.mode == Mode::IMM) ? -128 : 0, 0xFF));
+            }
+            else if (info.length == 2) {
+                int32_t word = value(statement.operand, 0, 0xFFFF);
+                bytes.push_back(word);
+                bytes.push_back(word >> 8);
+            }
+            continue;
+        }
+
+        for_each_item(statement.operand, [this, &statement, &value](std::string_view item) {
+            if (item[0] == '"') {
+                bytes.insert(bytes.end(), item.begin() + 1, item.end() - 1);
+            }
+            else if (statement.kind == Kind::BYTE) {
+                bytes.push_back(value(item, -128, 0xFF));
+            }
+            else {
+                int32_t word = value(item, -0x8000, 0xFFFF);
+                bytes.push_back(word);
+                bytes.push_back(word >> 8);
+            }
+        });
+    }
+}
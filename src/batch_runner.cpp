@@ -0,0 +1,78 @@
+#include "batch_runner.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+BatchRunner::BatchRunner(size_t threads) : pool(threads) {
+    for (size_t i = 0; i < pool.size(); i++) {
+        machines.push_back(std::make_shared<RAM<0x10000>>());
+    }
+}
+
+std::vector<BatchResult> BatchRunner::run(const std::vector<BatchJob> &jobs) {
+    for (const auto &job : jobs) validate(job);
+
+    std::vector<BatchResult> results(jobs.size());
+    for (size_t i = 0; i < jobs.size(); i++) {
+        uint64_t cycle_limit = jobs[i].cycle_limit ? jobs[i].cycle_limit : default_cycle_limit;
+        pool.submit([this, &jobs, &results, i, cycle_limit](size_t worker) {
+            run_job(jobs[i], cycle_limit, machines[worker], results[i]);
+        });
+    }
+    pool.wait();
+    return results;
+}
+
+void BatchRunner::validate(const BatchJob &job) {
+    size_t image_size = job.image ? job.image->size() : 0;
+    if (job.load_address + image_size > 0x10000) {
+        throw std::invalid_argument("Image does not fit in memory");
+    }
+    for (const auto &range : job.capture) {
+        if (range.start + range.length > 0x10000) {
+            throw std::invalid_argument("Capture range does not fit in memory");
+        }
+    }
+}
+
+void BatchRunner::run_job(const BatchJob &job, uint64_t cycle_limit, const std::shared_ptr<RAM<0x10000>> &mem,
+                          BatchResult &result) {
+    mem->clear();
+    if (job.image) mem->load(job.load_address, job.image->data(), job.image->size());
+    mem->write_word(RST_VEC, job.reset_vector);
+
+    CPU6502 cpu(mem);
+    cpu.set_stop_on_brk(job.stop_on_brk);
+    RunResult run;
+    if (job.stop_pc) {
+        uint16_t stop_pc = *job.stop_pc;
+        run = cpu.run_until([&cpu, stop_pc] { return cpu.get_pc() == stop_pc; }, cycle_limit);
+    }
+    else {
+        run = cpu.run_cycles(cycle_limit);
+    }
+
+    result.reason = run.reason;
+    result.cycles = run.cycles;
+    result.registers = cpu.get_registers();
+    result.memory.clear();
+    for (const auto &range : job.capture) capture(mem, range, result.memory);
+}
+
+// A page at a time through the page table, falling back to read_byte for unmapped pages
+void BatchRunner::capture(const std::shared_ptr<RAM<0x10000>> &mem, const MemoryRange &range, std::vector<uint8_t> &out) {
+    const PageTable *pages = mem->page_table();
+    uint32_t addr = range.start, end = range.start + range.length;
+    out.reserve(out.size() + range.length);
+    while (addr < end) {
+        uint32_t chunk = std::min<uint32_t>(end, (addr & 0xFF00) + 0x100) - addr;
+        const uint8_t *page = pages ? pages->read[addr >> 8] : nullptr;
+        if (page) {
+            out.insert(out.end(), page + (addr & 0xFF), page + (addr & 0xFF) + chunk);
+        }
+        else {
+            for (uint32_t i = 0; i < chunk; i++) out.push_back(mem->read_byte(addr + i));
+        }
+        addr += chunk;
+    }
+}
@@ -0,0 +1,284 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <dirent.h>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cpu_6502.h"
+#include "instruction.h"
+#include "loader.h"
+#include "paged_memory.h"
+
+#ifndef CPU6502_BENCH_DIR
+#define CPU6502_BENCH_DIR "bench"
+#endif
+
+// Emulation speed benchmarks, printed as one JSON object per line
+//
+// opcode:  every legal opcode in Instructions::info, repeated in an unrolled loop
+// kernel:  small loops exercising one kind of workload each
+// program: every .hex image in the bench directory, run from reset until BRK
+namespace {
+
+typedef struct Benchmark {
+    std::string suite;
+    std::string name;
+    std::function<void(PagedMemory &mem)> load;
+    uint64_t budget;  // Cycles per run
+    bool stop_on_brk; // Whether runs end at a BRK rather than only at the budget
+} Benchmark;
+
+typedef struct Options {
+    double min_time = 0.1; // Seconds spent on each benchmark, at least
+    std::string filter;
+    std::string suite;
+    std::string programs = CPU6502_BENCH_DIR;
+    bool block_cache = false;
+    bool jit = false;
+} Options;
+
+const uint16_t code_start = 0x0600;
+const uint16_t data_start = 0x0300;   // Target of every absolute and indirect operand
+const uint8_t zero_page_operand = 0x80;
+const uint16_t irq_handler = 0x0500;
+const int unroll = 32;                // Copies of the instruction per loop
+const uint64_t loop_budget = 1 << 20; // Cycles per run of the benchmarks that never finish
+
+// Zero page filled with pointers to data_start, so every (zp,X) and (zp),Y lands in data
+// whatever the index, and a vector to an RTI so BRK returns
+void load_common(PagedMemory &mem) {
+    for (int i = 0; i < 0x100; i += 2) mem.write_word(i, data_start);
+    mem.write_byte(irq_handler, 0x40);
+    mem.write_word(IRQ_VEC, irq_handler);
+    mem.write_word(RST_VEC, code_start);
+}
+
+void load_code(PagedMemory &mem, const std::vector<uint8_t> &code) {
+    mem.load(code_start, code.data(), code.size());
+}
+
+// Appends JMP code_start, closing the loop
+void close_loop(std::vector<uint8_t> &code) {
+    code.insert(code.end(), { 0x4C, code_start & 0xFF, code_start >> 8 });
+}
+
+// The instruction repeated, with operands that keep it on the straight path through the loop
+Benchmark opcode_benchmark(uint8_t opcode, const InstrInfo &info) {
+    std::vector<uint8_t> code;
+    std::vector<uint16_t> pointers; // For JMP (ind), each copy's next instruction
+
+    if (opcode == 0x20 || opcode == 0x60) {
+        // JSR and RTS only make sense as a pair, calling an RTS just after the loop
+        uint16_t sub = code_start + 3*unroll + 3;
+        for (int i = 0; i < unroll; i++) code.insert(code.end(), { 0x20, (uint8_t) (sub & 0xFF), (uint8_t) (sub >> 8) });
+        close_loop(code);
+        code.push_back(0x60);
+    }
+    else if (opcode == 0x00 || opcode == 0x40) {
+        // BRK and RTI only make sense as a pair, BRK skipping a padding byte and the handler returning past it
+        for (int i = 0; i < unroll; i++) code.insert(code.end(), { 0x00, 0xEA });
+        close_loop(code);
+    }
+    else {
+        int length = Instructions::length_table[opcode];
+        for (int i = 0; i < unroll; i++) {
+            uint16_t next = code_start + code.size() + length + 1;
+            uint16_t operand = (length == 1) ? zero_page_operand : data_start;
+            if (info.mode == Mode::IMM) operand = 0x01;
+            if (info.mode == Mode::REL) operand = 0x00;  // Taken or not, a branch to the next instruction
+            if (opcode == 0x4C) operand = next;
+            if (opcode == 0x6C) {
+                operand = data_start + 2*pointers.size();
+                pointers.push_back(next);
+            }
+
+            code.push_back(opcode);
+            if (length >= 1) code.push_back(operand & 0xFF);
+            if (length == 2) code.push_back(operand >> 8);
+        }
+        close_loop(code);
+    }
+
+    auto load = [code, pointers](PagedMemory &mem) {
+        load_common(mem);
+        for (size_t i = 0; i < pointers.size(); i++) mem.write_word(data_start + 2*i, pointers[i]);
+        load_code(mem, code);
+    };
+    return { "opcode", std::string(Instructions::op_name(info.op)) + " " + Instructions::mode_name(info.mode), load, loop_budget, false };
+}
+
+Benchmark code_benchmark(const std::string &name, std::vector<uint8_t> code) {
+    auto load = [code](PagedMemory &mem) {
+        load_common(mem);
+        load_code(mem, code);
+    };
+    return { "kernel", name, load, loop_budget, false };
+}
+
+std::vector<Benchmark> kernel_benchmarks() {
+    std::vector<Benchmark> benchmarks;
+
+    // Copies 4 KiB from $1000 to $2000 with (zp),Y, over and over
+    //   start: LDA #$00 / STA $00 / STA $02 / LDA #$10 / STA $01 / LDA #$20 / STA $03 / LDX #$10 / LDY #0
+    //   copy:  LDA ($00),Y / STA ($02),Y / INY / BNE copy / INC $01 / INC $03 / DEX / BNE copy / JMP start
+    benchmarks.push_back(code_benchmark("memcpy", {
+        0xA9, 0x00, 0x85, 0x00, 0x85, 0x02, 0xA9, 0x10, 0x85, 0x01, 0xA9, 0x20, 0x85, 0x03, 0xA2, 0x10,
+        0xA0, 0x00, 0xB1, 0x00, 0x91, 0x02, 0xC8, 0xD0, 0xF9, 0xE6, 0x01, 0xE6, 0x03, 0xCA, 0xD0, 0xF2,
+        0x4C, 0x00, 0x06 }));
+
+    // Decimal mode counters: a 16-bit BCD count up in $10-$11, and a count down by 7 in $12
+    //   start: SED
+    //   loop:  CLC / LDA $10 / ADC #$01 / STA $10 / LDA $11 / ADC #$00 / STA $11
+    //          SEC / LDA $12 / SBC #$07 / STA $12 / JMP loop
+    benchmarks.push_back(code_benchmark("bcd", {
+        0xF8, 0x18, 0xA5, 0x10, 0x69, 0x01, 0x85, 0x10, 0xA5, 0x11, 0x69, 0x00, 0x85, 0x11, 0x38, 0xA5,
+        0x12, 0xE9, 0x07, 0x85, 0x12, 0x4C, 0x01, 0x06 }));
+
+    // A chain of 16 nested subroutines, each calling the next, then all returning
+    //   start: JSR s0 / JMP start
+    //   s0:    JSR s1 / RTS  ...  s14: JSR s15 / RTS
+    //   s15:   RTS
+    std::vector<uint8_t> calls = { 0x20, 0x06, 0x06, 0x4C, 0x00, 0x06 };
+    const int depth = 16;
+    for (int i = 0; i < depth - 1; i++) {
+        uint16_t next = code_start + calls.size() + 4;
+        calls.insert(calls.end(), { 0x20, (uint8_t) (next & 0xFF), (uint8_t) (next >> 8), 0x60 });
+    }
+    calls.push_back(0x60);
+    benchmarks.push_back(code_benchmark("jsr_rts_nesting", calls));
+
+    // Branches decided by an 8-bit LFSR in $10, so they follow no short pattern
+    //   start: LDA #$A5 / STA $10
+    //   loop:  LDA $10 / ASL A / BCC noeor / EOR #$1D
+    //   noeor: STA $10 / BMI neg / INX / BPL sign
+    //   neg:   DEX
+    //   sign:  AND #$0C / BEQ low / INY
+    //   low:   CMP #$08 / BCS high / BVC loop
+    //   high:  JMP loop
+    benchmarks.push_back(code_benchmark("branches", {
+        0xA9, 0xA5, 0x85, 0x10, 0xA5, 0x10, 0x0A, 0x90, 0x02, 0x49, 0x1D, 0x85, 0x10, 0x30, 0x03, 0xE8,
+        0x10, 0x01, 0xCA, 0x29, 0x0C, 0xF0, 0x01, 0xC8, 0xC9, 0x08, 0xB0, 0x02, 0x50, 0xE6, 0x4C, 0x04,
+        0x06 }));
+
+    return benchmarks;
+}
+
+std::vector<Benchmark> program_benchmarks(const std::string &directory) {
+    std::vector<std::string> names;
+    if (DIR *dir = opendir(directory.c_str())) {
+        while (dirent *entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.size() > 4 && name.compare(name.size() - 4, 4, ".hex") == 0) names.push_back(name);
+        }
+        closedir(dir);
+    }
+    std::sort(names.begin(), names.end());
+
+    std::vector<Benchmark> benchmarks;
+    for (const auto &name : names) {
+        auto image = std::make_shared<ProgramImage>(Loader::load(directory + "/" + name));
+        auto load = [image](PagedMemory &mem) { image->load_into(mem); };
+        benchmarks.push_back({ "program", name.substr(0, name.size() - 4), load,
+                               std::numeric_limits<uint64_t>::max(), true });
+    }
+    return benchmarks;
+}
+
+void run_benchmark(const Benchmark &benchmark, const Options &options) {
+    auto mem = std::make_shared<PagedMemory>();
+    benchmark.load(*mem);
+    PagedMemory::Snapshot start = mem->snapshot();
+
+    CPU6502<PagedMemory> cpu(mem);
+    cpu.set_stop_on_brk(benchmark.stop_on_brk);
+    cpu.set_block_cache(options.block_cache);
+    cpu.set_jit(options.jit);
+
+    // Runs are deterministic, so instructions are counted once, outside the timed runs
+    uint64_t counted = 0;
+    RunResult counting = cpu.run_until([&counted] { counted++; return false; }, benchmark.budget);
+    // The predicate is also asked once before the BRK that ends the run
+    uint64_t instructions_per_run = counted - (counting.reason == StopReason::BRK ? 1 : 0);
+
+    uint64_t runs = 0, cycles = 0;
+    double seconds = 0;
+    while (runs == 0 || seconds < options.min_time) {
+        mem->restore(start);
+        cpu.invalidate_code();
+        cpu.reset();
+
+        auto begin = std::chrono::steady_clock::now();
+        RunResult result = cpu.run_cycles(benchmark.budget);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        cycles += result.cycles;
+        runs++;
+    }
+    uint64_t instructions = instructions_per_run * runs;
+
+    const char *engine = options.jit ? "jit" : options.block_cache ? "block_cache" : "interpreter";
+    std::cout << std::fixed << std::setprecision(3)
+              << "{\"suite\": \"" << benchmark.suite << "\", \"name\": \"" << benchmark.name << "\""
+              << ", \"engine\": \"" << engine << "\""
+              << ", \"runs\": " << runs
+              << ", \"instructions\": " << instructions
+              << ", \"cycles\": " << cycles
+              << ", \"seconds\": " << std::setprecision(6) << seconds
+              << ", \"ns_per_instruction\": " << std::setprecision(3) << seconds * 1e9 / instructions
+              << ", \"emulated_mhz\": " << cycles / seconds / 1e6
+              << ", \"mips\": " << instructions / seconds / 1e6 << "}" << std::endl;
+}
+
+void usage(const char *name) {
+    std::cout << "Usage: " << name << " [options]\n"
+              << "  --suite opcode|kernel|program  Run only one suite\n"
+              << "  --filter TEXT                  Run only benchmarks whose name contains TEXT\n"
+              << "  --time SECONDS                 Minimum time spent on each benchmark (default 0.1)\n"
+              << "  --programs DIR                 Directory of .hex images (default " CPU6502_BENCH_DIR ")\n"
+              << "  --block-cache                  Enable the decoded block cache\n"
+              << "  --jit                          Enable the x86-64 recompiler, if compiled in\n";
+}
+
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        bool has_value = i + 1 < argc;
+        if (option == "--suite" && has_value) options.suite = argv[++i];
+        else if (option == "--filter" && has_value) options.filter = argv[++i];
+        else if (option == "--time" && has_value) options.min_time = std::atof(argv[++i]);
+        else if (option == "--programs" && has_value) options.programs = argv[++i];
+        else if (option == "--block-cache") options.block_cache = true;
+        else if (option == "--jit") options.jit = true;
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<Benchmark> benchmarks;
+    try {
+        for (int opcode = 0; opcode < 0x100; opcode++) {
+            if (Instructions::is_legal(opcode)) benchmarks.push_back(opcode_benchmark(opcode, Instructions::info[opcode]));
+        }
+        for (auto &benchmark : kernel_benchmarks()) benchmarks.push_back(benchmark);
+        for (auto &benchmark : program_benchmarks(options.programs)) benchmarks.push_back(benchmark);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    for (const auto &benchmark : benchmarks) {
+        if (!options.suite.empty() && benchmark.suite != options.suite) continue;
+        if (benchmark.name.find(options.filter) == std::string::npos) continue;
+        run_benchmark(benchmark, options);
+    }
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include "cpu_6502.h"
+#include "debugger.h"
+#include "disassembler.h"
+
+namespace {
+
+// Applies f to each bit index of [start, start+length) within the address space
+template <class F>
+void for_range(uint16_t start, uint32_t length, F f) {
+    uint32_t end = std::min<uint32_t>(start + length, 0x10000);
+    for (uint32_t addr = start; addr < end; addr++) f(addr);
+}
+
+}
+
+void Debugger::add_watchpoint(uint16_t start, uint32_t length, WatchKind kind) {
+    bool read = (int) kind & (int) WatchKind::READ, write = (int) kind & (int) WatchKind::WRITE;
+    for_range(start, length, [this, read, write](uint32_t addr) {
+        if (read) watch_read.set(addr);
+        if (write) watch_write.set(addr);
+    });
+}
+
+void Debugger::remove_watchpoint(uint16_t start, uint32_t length, WatchKind kind) {
+    bool read = (int) kind & (int) WatchKind::READ, write = (int) kind & (int) WatchKind::WRITE;
+    for_range(start, length, [this, read, write](uint32_t addr) {
+        if (read) watch_read.reset(addr);
+        if (write) watch_write.reset(addr);
+    });
+}
+
+void Debugger::clear() {
+    breakpoints.reset();
+    watch_read.reset();
+    watch_write.reset();
+}
+
+bool Debugger::is_watched(uint16_t addr, WatchKind kind) const {
+    return (((int) kind & (int) WatchKind::READ) && watch_read[addr])
+        || (((int) kind & (int) WatchKind::WRITE) && watch_write[addr]);
+}
+
+std::string Debugger::to_string(const DebugEvent &event) {
+    std::stringstream ss;
+    ss << std::uppercase << std::hex << std::setfill('0');
+    switch (event.kind) {
+        case DebugEventKind::NONE:
+            ss << "No event";
+            break;
+        case DebugEventKind::BREAKPOINT:
+            ss << "Breakpoint at $" << std::setw(4) << event.PC;
+            break;
+        case DebugEventKind::READ:
+            ss << "Read $" << std::setw(2) << (int) event.value << " from $" << std::setw(4) << event.address
+               << " at $" << std::setw(4) << event.PC;
+            break;
+        case DebugEventKind::WRITE:
+            ss << "Wrote $" << std::setw(2) << (int) event.value << " to $" << std::setw(4) << event.address
+               << " at $" << std::setw(4) << event.PC;
+            break;
+    }
+    return ss.str();
+}
+
+std::string Debugger::registers_to_string(const Registers &registers) {
+    static const char flag_names[] = "NV-BDIZC";
+    std::stringstream ss;
+    ss << std::uppercase << std::hex << std::setfill('0')
+       << "PC=" << std::setw(4) << registers.PC
+       << " A=" << std::setw(2) << (int) registers.A
+       << " X=" << std::setw(2) << (int) registers.X
+       << " Y=" << std::setw(2) << (int) registers.Y
+       << " S=" << std::setw(2) << (int) registers.S
+       << " P=" << std::setw(2) << (int) registers.P << ' ';
+    for (int bit = 7; bit >= 0; bit--) {
+        ss << ((registers.P & (1 << bit)) ? flag_names[7 - bit] : '.');
+    }
+    return ss.str();
+}
+
+void Debugger::print_memory(std::ostream &out, Memory &mem, uint16_t start, uint32_t length) {
+    std::ios::fmtflags flags = out.flags();
+    char fill = out.fill();
+    uint32_t end = std::min<uint32_t>(start + length, 0x10000);
+    for (uint32_t row = start & ~0xF; row < end; row += 0x10) {
+        std::string text;
+        out << std::uppercase << std::hex << std::setfill('0') << std::setw(4) << row << ' ';
+        for (uint32_t addr = row; addr < row + 0x10; addr++) {
+            if (addr < start || addr >= end) {
+                out << "   ";
+                text += ' ';
+                continue;
+            }
+            uint8_t byte = mem.read_byte(addr);
+            out << ' ' << std::setw(2) << (int) byte;
+            text += (byte >= 0x20 && byte < 0x7F) ? (char) byte : '.';
+        }
+        out << "  " << text << '\n';
+    }
+    out.flags(flags);
+    out.fill(fill);
+}
+
+void Debugger::print_disassembly(std::ostream &out, Memory &mem, uint16_t start, size_t count) {
+    // Instructions are at most 3 bytes long
+    std::vector<uint8_t> bytes;
+    for (uint32_t addr = start; addr < 0x10000 && bytes.size() < count * 3; addr++) {
+        bytes.push_back(mem.read_byte(addr));
+    }
+    RecordSink sink;
+    Disassembler(start).disassemble(bytes.data(), bytes.size(), sink);
+
+    std::ios::fmtflags flags = out.flags();
+    char fill = out.fill();
+    out << std::uppercase << std::hex << std::setfill('0');
+    for (size_t i = 0; i < std::min(count, sink.records.size()); i++) {
+        const DisasmRecord &record = sink.records[i];
+        out << std::setw(4) << record.address << "  ";
+        for (int b = 0; b < 3; b++) {
+            if (b < record.length) out << std::setw(2) << (int) bytes[record.address - start + b] << ' ';
+            else out << "   ";
+        }
+        bool instruction = Disassembler::is_instruction(record.opcode)
+            && record.length == Instructions::length_table[record.opcode] + 1;
+        out << ' ' << (instruction ? Disassembler::to_string(record) : "???") << '\n';
+    }
+    out.flags(flags);
+    out.fill(fill);
+}
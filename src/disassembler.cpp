@@ -1,61 +1,198 @@
-#include <iostream>
+#include <algorithm>
+#include <cstring>
 
 #include "disassembler.h"
+#include "mapped_file.h"
 
-std::string Disassembler::instr_to_string(InstrInfo info, uint16_t PC, uint16_t src) {
-    std::stringstream instr_ss;
+namespace {
 
-    // TODO: Relative addresses and such
-    if (info.mode_str.compare("REL") == 0) {
-        src = PC + 2 + (int16_t) src;
+const char hex_digits[] = "0123456789ABCDEF";
+
+inline char *put_hex(char *out, unsigned value, int digits) {
+    for (int i = digits - 1; i >= 0; i--) {
+        out[i] = hex_digits[value & 0xF];
+        value >>= 4;
     }
-    instr_ss << std::uppercase << info.op_str << std::hex << std::setfill('0');
-    std::string format = Instructions::mode_map.at(info.mode_str).format;
-    size_t len = format.length();
-    if (len != 0) instr_ss << " ";
-    for (unsigned i = 0; i < len; i++) {
-        switch (format[i]) {
-            case 'b':
-                instr_ss << std::setw(2) << src;
-                break;
-
-            case 'w':
-                instr_ss << std::setw(4) << src;
-                break;
-
-            default:
-                instr_ss << format[i];
-                break;
+    return out + digits;
+}
+
+inline char *put(char *out, const char *text, size_t length) {
+    std::memcpy(out, text, length);
+    return out + length;
+}
+
+// An addressing mode format such as "($b),Y", split around its operand
+typedef struct OpText {
+    char mnemonic[3];
+    bool known;
+    bool relative;   // The operand is a branch offset, printed as its target
+    uint8_t digits;  // Hex digits of the operand, 0 if it has none
+    uint8_t prefix_length, suffix_length;
+    char prefix[4], suffix[4];
+} OpText;
+
+// Built from the opcode table the first time it is needed, so formatting does no parsing of mode formats
+const std::array<OpText, 0x100> &op_texts() {
+    static const std::array<OpText, 0x100> texts = [] {
+        std::array<OpText, 0x100> texts{};
+        for (int opcode = 0; opcode < 0x100; opcode++) {
+            const InstrInfo &info = Instructions::info[opcode];
+            if (info.op == Op::ILLEGAL) continue;
+            OpText &text = texts[opcode];
+            std::string format = Instructions::mode_format(info.mode);
+            std::memcpy(text.mnemonic, Instructions::op_name(info.op), 3);
+            text.known = true;
+            text.relative = info.mode == Mode::REL;
+
+            size_t operand = format.find_first_of("bw");
+            std::string prefix = format.substr(0, operand);
+            std::string suffix = (operand == std::string::npos) ? "" : format.substr(operand + 1);
+            text.digits = (operand == std::string::npos) ? 0 : (format[operand] == 'w') ? 4 : 2;
+            text.prefix_length = prefix.size();
+            text.suffix_length = suffix.size();
+            std::memcpy(text.prefix, prefix.data(), prefix.size());
+            std::memcpy(text.suffix, suffix.data(), suffix.size());
+        }
+        return texts;
+    }();
+    return texts;
+}
+
+// Bytes taken by the record starting with each opcode, 1 for data bytes
+const std::array<uint8_t, 0x100> &record_lengths() {
+    static const std::array<uint8_t, 0x100> lengths = [] {
+        std::array<uint8_t, 0x100> lengths;
+        for (int opcode = 0; opcode < 0x100; opcode++) {
+            lengths[opcode] = op_texts()[opcode].known ? Instructions::length_table[opcode] + 1 : 1;
         }
+        return lengths;
+    }();
+    return lengths;
+}
+
+}
+
+bool Disassembler::is_instruction(uint8_t opcode) {
+    return op_texts()[opcode].known;
+}
+
+size_t Disassembler::format(const DisasmRecord &record, char *out) {
+    const OpText &text = op_texts()[record.opcode];
+    char *end = out;
+    if (!text.known || record.length != Instructions::length_table[record.opcode] + 1) {
+        end = put(end, ".BYTE $", 7);
+        end = put_hex(end, record.opcode, 2);
+        return end - out;
+    }
+
+    end = put(end, text.mnemonic, 3);
+    if (text.prefix_length + text.digits + text.suffix_length == 0) return end - out;
+    *end++ = ' ';
+    end = put(end, text.prefix, text.prefix_length);
+    if (text.digits) {
+        uint16_t value = text.relative ? record.address + 2 + (int8_t) record.operand : record.operand;
+        end = put_hex(end, value, text.digits);
     }
+    end = put(end, text.suffix, text.suffix_length);
+    return end - out;
+}
 
-    return instr_ss.str();
+std::string Disassembler::to_string(const DisasmRecord &record) {
+    char text[max_text_length];
+    return std::string(text, format(record, text));
 }
 
-void Disassembler::file_to_strings(std::ifstream &file) {
-    uint8_t opcode;
-    uint16_t src;
+void Disassembler::disassemble(const uint8_t *data, size_t size, DisasmSink &sink) const {
+    DisasmRecord batch[batch_size];
+    const auto &lengths = record_lengths();
+    static const uint16_t operand_masks[4] = { 0, 0, 0xFF, 0xFFFF }; // By record length
+    size_t bank_length = bank_size ? bank_size : size;
+
+    for (size_t bank_start = 0, bank = 0; bank_start < size; bank_start += bank_length, bank++) {
+        if (bank_size) sink.begin_bank(bank);
+        const uint8_t *bytes = data + bank_start;
+        size_t length = std::min(bank_length, size - bank_start);
+
+        size_t count = 0;
+        size_t i = 0;
+        while (i < length) {
+            DisasmRecord &record = batch[count];
+            uint8_t opcode = bytes[i];
+            uint8_t record_length = lengths[opcode];
+            record.address = base + i;
+            record.opcode = opcode;
 
-    char temp;
-    uint16_t PC = base;
-    InstrInfo info;
-    short length;
-    while (file.read(&temp, 1)) {
-        opcode = temp;
-        if (!Instructions::instr_map.count(opcode)) {
-            PC++;
-            continue;
+            // Away from the end of the bank, the operand is an unaligned load masked to its length,
+            // which keeps the loop free of branches on the opcode
+            if (i + 3 <= length) {
+                uint16_t operand;
+                std::memcpy(&operand, &bytes[i + 1], 2);
+                record.operand = operand & operand_masks[record_length];
+            } else if (i + record_length > length) {
+                // An instruction running off the end of the bank becomes data bytes
+                record_length = 1;
+                record.operand = 0;
+            } else {
+                record.operand = (record_length == 2) ? bytes[i + 1] : 0;
+            }
+            record.length = record_length;
+            i += record_length;
+
+            if (++count == batch_size) {
+                sink.write(batch, count);
+                count = 0;
+            }
         }
-        info = Instructions::instr_map.at(opcode);
-        length = Instructions::mode_map.at(info.mode_str).length;
+        if (count) sink.write(batch, count);
+    }
+    sink.finish();
+}
+
+void Disassembler::disassemble_file(const std::string &path, DisasmSink &sink) const {
+    MappedFile file(path);
+    disassemble(file.data(), file.size(), sink);
+}
+
+TextSink::TextSink(std::ostream &out, size_t buffer_size)
+    : out(out), buffer(std::max(buffer_size, max_line_length)) {}
 
-        src = 0;
-        for (int i = 0; i < length; i++) {
-            file.read(&temp, 1);
-            src |= temp << 8*i;
+TextSink::~TextSink() {
+    flush();
+}
+
+void TextSink::flush() {
+    out.write(buffer.data(), used);
+    used = 0;
+}
+
+void TextSink::write(const DisasmRecord *records, size_t count) {
+    for (size_t r = 0; r < count; r++) {
+        if (buffer.size() - used < max_line_length) flush();
+        const DisasmRecord &record = records[r];
+
+        // "0600  B1 20       LDA ($20),Y"
+        char *line = buffer.data() + used;
+        char *end = put_hex(line, record.address, 4);
+        end = put(end, "  ", 2);
+        char *bytes = end;
+        end = put(end, "          ", 10);
+        put_hex(bytes, record.opcode, 2);
+        for (int i = 1; i < record.length; i++) {
+            put_hex(bytes + 3*i, record.operand >> 8*(i - 1), 2);
         }
-        std::cout << std::hex << std::setfill('0') << std::setw(4) << (int) PC << " " << std::setw(2) << (int) opcode << " " << std::setw(4) << (int) src << " " << instr_to_string(info, PC, src) << std::endl;
-        instructions.push_back(instr_to_string(info, PC, src));
-        PC += length + 1;
+        end += Disassembler::format(record, end);
+        *end++ = '\n';
+        used = end - buffer.data();
     }
 }
+
+void TextSink::begin_bank(size_t bank) {
+    std::string header = "; bank " + std::to_string(bank) + "\n";
+    if (buffer.size() - used < header.size()) flush();
+    used = put(buffer.data() + used, header.data(), header.size()) - buffer.data();
+}
+
+void TextSink::finish() {
+    flush();
+    out.flush();
+}
@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "event_scheduler.h"
+
+namespace {
+
+// Heap order, putting the earliest event, and the first posted of those due together, at the front
+template <class Event>
+bool later(const Event &a, const Event &b) {
+    return a.due > b.due || (a.due == b.due && a.sequence > b.sequence);
+}
+
+}
+
+EventScheduler::id_t EventScheduler::schedule(uint64_t due, callback_t callback) {
+    if (!callback) throw std::invalid_argument("Event has no callback");
+
+    uint32_t slot;
+    if (free_slots.empty()) {
+        slot = slots.size();
+        slots.push_back({ nullptr, 0 });
+    }
+    else {
+        slot = free_slots.back();
+        free_slots.pop_back();
+    }
+    slots[slot].callback = std::move(callback);
+    id_t id = (id_t) slots[slot].generation << 32 | slot;
+
+    heap.push_back({ due, next_sequence++, id });
+    std::push_heap(heap.begin(), heap.end(), later<Event>);
+    this->due = heap.front().due;
+    live++;
+    return id;
+}
+
+bool EventScheduler::cancel(id_t id) {
+    if ((uint32_t) id >= slots.size() || !is_live(id)) return false;
+
+    release(id);
+    if (!is_live(heap.front().id)) pop();
+    // Cancelled events far in the future could otherwise pile up in the heap
+    else if (heap.size() > 2 * live + 64) compact();
+    return true;
+}
+
+void EventScheduler::clear() {
+    for (const auto &event : heap) {
+        if (is_live(event.id)) release(event.id);
+    }
+    heap.clear();
+    due = never;
+}
+
+void EventScheduler::run_due(uint64_t cycle) {
+    while (due <= cycle) {
+        // Taken off the heap first, since the callback may change it
+        Event event = heap.front();
+        callback_t callback = release(event.id);
+        pop();
+        callback(event.due);
+    }
+}
+
+EventScheduler::callback_t EventScheduler::release(id_t id) {
+    Slot &slot = slots[(uint32_t) id];
+    callback_t callback = std::move(slot.callback);
+    slot.callback = nullptr;
+    slot.generation++;
+    free_slots.push_back((uint32_t) id);
+    live--;
+    return callback;
+}
+
+// Removes the front event, then any cancelled ones that reach the front after it
+void EventScheduler::pop() {
+    do {
+        std::pop_heap(heap.begin(), heap.end(), later<Event>);
+        heap.pop_back();
+    } while (!heap.empty() && !is_live(heap.front().id));
+    due = heap.empty() ? never : heap.front().due;
+}
+
+// Drops every cancelled event and rebuilds the heap from the live ones
+void EventScheduler::compact() {
+    heap.erase(std::remove_if(heap.begin(), heap.end(), [this](const Event &event) { return !is_live(event.id); }),
+               heap.end());
+    std::make_heap(heap.begin(), heap.end(), later<Event>);
+    due = heap.empty() ? never : heap.front().due;
+}
@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+
+#include "cpu_6502.h"
+#include "flow_analyzer.h"
+
+namespace {
+
+// What an instruction does to the flow of control
+enum class Flow {
+    NEXT,     // Falls through
+    BRANCH,   // Falls through or goes to its target
+    JUMP,     // Goes to its target
+    CALL,     // Calls its target, then falls through
+    INDIRECT, // Goes somewhere not known statically
+    STOP      // Returns or traps
+};
+
+Flow flow_of(uint8_t opcode) {
+    const InstrInfo &info = Instructions::info[opcode];
+    switch (info.op) {
+        case Op::JMP: return (info.mode == Mode::ABI) ? Flow::INDIRECT : Flow::JUMP;
+        case Op::JSR: return Flow::CALL;
+        case Op::BRK: case Op::RTI: case Op::RTS: return Flow::STOP;
+        default:      return (info.mode == Mode::REL) ? Flow::BRANCH : Flow::NEXT;
+    }
+}
+
+uint16_t target_of(const DisasmRecord &record) {
+    return (flow_of(record.opcode) == Flow::BRANCH) ? record.address + 2 + (int8_t) record.operand : record.operand;
+}
+
+bool xref_less(const Xref &a, const Xref &b) {
+    return std::tie(a.to, a.from, a.kind) < std::tie(b.to, b.from, b.kind);
+}
+
+std::string hex_name(const char *prefix, uint16_t address) {
+    std::stringstream ss;
+    ss << prefix << std::uppercase << std::hex << std::setfill('0') << std::setw(4) << address;
+    return ss.str();
+}
+
+// Keeps the label of highest precedence at each address
+void add_label(std::map<uint16_t, Label> &labels, uint16_t address, LabelKind kind, std::string name) {
+    auto it = labels.find(address);
+    if (it == labels.end()) labels.emplace(address, Label{ kind, std::move(name) });
+    else if (kind < it->second.kind) it->second = Label{ kind, std::move(name) };
+}
+
+}
+
+struct FlowAnalyzer::Analysis {
+    // Results of the routines traced by one worker, merged once every routine is done
+    typedef struct Partial {
+        std::vector<DisasmRecord> instructions;
+        std::vector<Xref> xrefs;
+        std::vector<Xref> bad_targets;
+        std::vector<uint16_t> indirect_jumps;
+    } Partial;
+
+    const FlowImage &image;
+    std::map<uint16_t, Label> roots; // Entry points, with their labels
+    std::unique_ptr<std::atomic<uint8_t>[]> decoded;  // Non-zero once an instruction start has been claimed
+    std::unique_ptr<std::atomic<uint8_t>[]> routines; // Non-zero once a routine has been queued
+    std::vector<Partial> partials;                    // One per worker
+
+    Analysis(const FlowImage &image, size_t workers)
+        : image(image), decoded(new std::atomic<uint8_t>[0x10000]()),
+          routines(new std::atomic<uint8_t>[0x10000]()), partials(workers) {}
+
+    // Decodes the instruction at address, if all of it lies in the image and it is a known opcode
+    bool decode(uint16_t address, DisasmRecord &record) const {
+        if (address < image.base) return false;
+        size_t offset = address - image.base;
+        if (offset >= image.size || !Disassembler::is_instruction(image.data[offset])) return false;
+
+        uint8_t opcode = image.data[offset];
+        size_t length = Instructions::length_table[opcode] + 1;
+        if (offset + length > image.size) return false;
+
+        record.address = address;
+        record.opcode = opcode;
+        record.length = length;
+        record.operand = 0;
+        for (size_t i = 1; i < length; i++) record.operand |= image.data[offset + i] << 8*(i - 1);
+        return true;
+    }
+};
+
+FlowAnalyzer::FlowAnalyzer(size_t threads) : pool(threads) {}
+
+FlowGraph FlowAnalyzer::analyze(const FlowImage &image) {
+    return std::move(analyze(std::vector<FlowImage>{ image })[0]);
+}
+
+std::vector<FlowGraph> FlowAnalyzer::analyze(const std::vector<FlowImage> &images) {
+    std::vector<std::unique_ptr<Analysis>> analyses;
+    for (const auto &image : images) {
+        if (image.base + image.size > 0x10000) {
+            throw std::invalid_argument("Image does not fit in memory");
+        }
+        analyses.push_back(std::make_unique<Analysis>(image, pool.size()));
+        Analysis &analysis = *analyses.back();
+
+        if (image.use_vectors) {
+            const std::pair<uint16_t, const char*> vectors[] = {{ RST_VEC, "reset" }, { NMI_VEC, "nmi" }, { IRQ_VEC, "irq" }};
+            for (const auto &vector : vectors) {
+                if (vector.first < image.base || vector.first + 2u > image.base + image.size) continue;
+                const uint8_t *bytes = &image.data[vector.first - image.base];
+                add_label(analysis.roots, bytes[0] | (bytes[1] << 8), LabelKind::VECTOR, vector.second);
+            }
+        }
+        for (uint16_t entry : image.entries) {
+            add_label(analysis.roots, entry, LabelKind::ENTRY, hex_name("entry_", entry));
+        }
+    }
+
+    for (auto &analysis : analyses) {
+        for (const auto &root : analysis->roots) spawn(*analysis, root.first);
+    }
+    pool.wait();
+
+    std::vector<FlowGraph> graphs(images.size());
+    for (size_t i = 0; i < images.size(); i++) merge(*analyses[i], graphs[i]);
+    return graphs;
+}
+
+void FlowAnalyzer::spawn(Analysis &analysis, uint16_t entry) {
+    if (analysis.routines[entry].exchange(1)) return;
+    pool.submit([this, &analysis, entry](size_t worker) {
+        trace_routine(analysis, entry, worker);
+    });
+}
+
+// Follows every path through a routine, leaving the routines it calls to their own tasks
+void FlowAnalyzer::trace_routine(Analysis &analysis, uint16_t entry, size_t worker) {
+    Analysis::Partial &partial = analysis.partials[worker];
+    std::vector<Xref> pending = {{ entry, entry, XrefKind::CALL }};
+
+    while (!pending.empty()) {
+        Xref edge = pending.back();
+        pending.pop_back();
+
+        uint16_t address = edge.to;
+        while (true) {
+            DisasmRecord record;
+            if (!analysis.decode(address, record)) {
+                partial.bad_targets.push_back(edge);
+                break;
+            }
+            if (analysis.decoded[address].exchange(1)) break;
+            partial.instructions.push_back(record);
+
+            Flow flow = flow_of(record.opcode);
+            uint16_t next = address + record.length;
+            if (flow == Flow::BRANCH || flow == Flow::JUMP) {
+                Xref xref{ address, target_of(record), (flow == Flow::BRANCH) ? XrefKind::BRANCH : XrefKind::JUMP };
+                partial.xrefs.push_back(xref);
+                pending.push_back(xref);
+            }
+            else if (flow == Flow::CALL) {
+                Xref xref{ address, target_of(record), XrefKind::CALL };
+                partial.xrefs.push_back(xref);
+                DisasmRecord callee;
+                if (analysis.decode(xref.to, callee)) spawn(analysis, xref.to);
+                else partial.bad_targets.push_back(xref);
+            }
+            else if (flow == Flow::INDIRECT) {
+                partial.indirect_jumps.push_back(address);
+            }
+
+            if (flow == Flow::JUMP || flow == Flow::INDIRECT || flow == Flow::STOP) break;
+            edge = { address, next, XrefKind::FALL_THROUGH };
+            address = next;
+        }
+    }
+}
+
+void FlowAnalyzer::merge(Analysis &analysis, FlowGraph &graph) {
+    for (auto &partial : analysis.partials) {
+        graph.instructions.insert(graph.instructions.end(), partial.instructions.begin(), partial.instructions.end());
+        graph.xrefs.insert(graph.xrefs.end(), partial.xrefs.begin(), partial.xrefs.end());
+        graph.bad_targets.insert(graph.bad_targets.end(), partial.bad_targets.begin(), partial.bad_targets.end());
+        graph.indirect_jumps.insert(graph.indirect_jumps.end(), partial.indirect_jumps.begin(), partial.indirect_jumps.end());
+    }
+    std::sort(graph.instructions.begin(), graph.instructions.end(),
+              [](const DisasmRecord &a, const DisasmRecord &b) { return a.address < b.address; });
+    std::sort(graph.xrefs.begin(), graph.xrefs.end(), xref_less);
+    std::sort(graph.bad_targets.begin(), graph.bad_targets.end(), xref_less);
+    std::sort(graph.indirect_jumps.begin(), graph.indirect_jumps.end());
+
+    // Labels, for entry points and for every target that decoded
+    graph.labels = analysis.roots;
+    for (const auto &xref : graph.xrefs) {
+        if (!graph.instruction_at(xref.to)) continue;
+        if (xref.kind == XrefKind::CALL) add_label(graph.labels, xref.to, LabelKind::SUBROUTINE, hex_name("sub_", xref.to));
+        else add_label(graph.labels, xref.to, LabelKind::LOCAL, hex_name("L_", xref.to));
+    }
+
+    // Blocks start at labels, and end at labels, gaps and anything but a call or plain instruction
+    FlowBlock *block = nullptr;
+    for (const auto &record : graph.instructions) {
+        if (block && (block->end != record.address || graph.labels.count(record.address))) {
+            // Fell through into the next block
+            if (block->end == record.address) block->successors.push_back(record.address);
+            block = nullptr;
+        }
+        if (!block) {
+            graph.blocks.push_back({ record.address, record.address, {} });
+            block = &graph.blocks.back();
+        }
+        block->end = record.address + record.length;
+
+        Flow flow = flow_of(record.opcode);
+        if (flow == Flow::NEXT || flow == Flow::CALL) continue;
+        if (flow == Flow::BRANCH) block->successors.push_back(block->end);
+        if (flow == Flow::BRANCH || flow == Flow::JUMP) block->successors.push_back(target_of(record));
+        block = nullptr;
+    }
+}
+
+const DisasmRecord *FlowGraph::instruction_at(uint16_t address) const {
+    auto it = std::lower_bound(instructions.begin(), instructions.end(), address,
+                               [](const DisasmRecord &record, uint16_t address) { return record.address < address; });
+    return (it != instructions.end() && it->address == address) ? &*it : nullptr;
+}
+
+std::pair<std::vector<Xref>::const_iterator, std::vector<Xref>::const_iterator> FlowGraph::refs_to(uint16_t address) const {
+    return std::equal_range(xrefs.begin(), xrefs.end(), Xref{ 0, address, XrefKind::FALL_THROUGH },
+                            [](const Xref &a, const Xref &b) { return a.to < b.to; });
+}
+
+void FlowGraph::print(std::ostream &out, const FlowImage &image) const {
+    out << std::uppercase << std::hex << std::setfill('0');
+    auto bytes_column = [&](uint32_t address, size_t count) {
+        std::stringstream ss;
+        ss << std::uppercase << std::hex << std::setfill('0');
+        for (size_t i = 0; i < count; i++) ss << (i ? " " : "") << std::setw(2) << (int) image.data[address - image.base + i];
+        out << std::setw(4) << address << "  " << std::left << std::setfill(' ') << std::setw(10) << ss.str()
+            << std::right << std::setfill('0');
+    };
+
+    uint32_t end = image.base + image.size;
+    uint32_t address = image.base;
+    while (address < end) {
+        auto label = labels.find(address);
+        if (label != labels.end()) {
+            out << label->second.name << ":";
+            auto refs = refs_to(address);
+            if (refs.first != refs.second) {
+                out << " ; xref";
+                int shown = 0;
+                for (auto it = refs.first; it != refs.second && shown < 4; it++, shown++) out << " " << std::setw(4) << it->from;
+                if (refs.second - refs.first > 4) out << " ...";
+            }
+            out << "\n";
+        }
+
+        const DisasmRecord *record = instruction_at(address);
+        if (record) {
+            bytes_column(address, record->length);
+            Flow flow = flow_of(record->opcode);
+            auto target = labels.find(target_of(*record));
+            if ((flow == Flow::BRANCH || flow == Flow::JUMP || flow == Flow::CALL) && target != labels.end()) {
+                out << Instructions::op_name(Instructions::info[record->opcode].op) << " " << target->second.name << "\n";
+            } else {
+                out << Disassembler::to_string(*record) << "\n";
+            }
+            address += record->length;
+            continue;
+        }
+
+        // Bytes never reached as code, up to 8 a line, stopping short of the next instruction or label
+        size_t count = 0;
+        while (count < 8 && address + count < end
+               && (count == 0 || (!instruction_at(address + count) && !labels.count(address + count)))) {
+            count++;
+        }
+        bytes_column(address, 0);
+        out << ".BYTE ";
+        for (size_t i = 0; i < count; i++) out << (i ? ",$" : "$") << std::setw(2) << (int) image.data[address - image.base + i];
+        out << "\n";
+        address += count;
+    }
+    out << std::dec << std::nouppercase;
+}
@@ -0,0 +1,63 @@
+#include <cstring>
+
+#include "framebuffer_renderer.h"
+
+const std::array<sf::Color, 16> FramebufferRenderer::palette = {
+    sf::Color::Black,
+    sf::Color::White,
+    sf::Color::Red,
+    sf::Color::Cyan,
+    sf::Color::Magenta,
+    sf::Color::Green,
+    sf::Color::Blue,
+    sf::Color::Yellow,
+    sf::Color(0xFA, 0xA5, 0x00),
+    sf::Color(0xFF, 0xF8, 0xDC),
+    sf::Color(0xFF, 0x4D, 0x4D),
+    sf::Color(0x69, 0x69, 0x69),
+    sf::Color(0xA9, 0xA9, 0xA9),
+    sf::Color(0xAE, 0xF3, 0x59),
+    sf::Color(0x63, 0xC5, 0xDA),
+    sf::Color(0xD3, 0xD3, 0xD3)
+};
+
+FramebufferRenderer::FramebufferRenderer(float scale) {
+    texture.create(width, height);
+    texture.setSmooth(false);
+    sprite.setTexture(texture, true);
+    sprite.setScale(scale, scale);
+
+    // Starts out showing a zeroed framebuffer
+    shown.fill(0);
+    for (size_t i = 0; i < size; i++) {
+        pixels[4*i] = palette[0].r;
+        pixels[4*i + 1] = palette[0].g;
+        pixels[4*i + 2] = palette[0].b;
+        pixels[4*i + 3] = palette[0].a;
+    }
+    texture.update(pixels.data());
+}
+
+bool FramebufferRenderer::update(const uint8_t *framebuffer) {
+    bool changed = false;
+    for (size_t page = 0; page < size / 0x100; page++) {
+        size_t offset = page * 0x100;
+        if (std::memcmp(&shown[offset], &framebuffer[offset], 0x100) == 0) continue;
+
+        std::memcpy(&shown[offset], &framebuffer[offset], 0x100);
+        for (size_t i = offset; i < offset + 0x100; i++) {
+            const sf::Color &color = palette[framebuffer[i] & 0xF];
+            pixels[4*i] = color.r;
+            pixels[4*i + 1] = color.g;
+            pixels[4*i + 2] = color.b;
+            pixels[4*i + 3] = color.a;
+        }
+        texture.update(&pixels[4*offset], width, rows_per_page, 0, page * rows_per_page);
+        changed = true;
+    }
+    return changed;
+}
+
+void FramebufferRenderer::draw(sf::RenderTarget &target) const {
+    target.draw(sprite);
+}
@@ -0,0 +1,291 @@
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "cpu_6502.h"
+#include "debugger.h"
+#include "loader.h"
+#include "paged_memory.h"
+#include "profiler.h"
+
+namespace {
+
+void usage(const char *name) {
+    std::cout << "Usage: " << name << " <image> [options]\n"
+              << "  --format FORMAT           raw, prg, hex, seg or asm, picked from the extension by default\n"
+              << "  --load ADDR               Load address of raw images and origin of assembly (default $0600)\n"
+              << "  --reset ADDR              Start at ADDR instead of the image's reset vector\n"
+              << "  --pc ADDR                 Stop when PC reaches ADDR\n"
+              << "  --cycles N                Stop after N cycles\n"
+              << "  --exit ADDR               Stop when ADDR is written, exiting with the value written\n"
+              << "  --no-brk                  Take BRK as an interrupt instead of stopping on it\n"
+              << "  --block-cache             Enable the decoded block cache\n"
+              << "  --jit                     Enable the x86-64 recompiler, if compiled in\n"
+              << "  --profile FILE            Write a per-PC, per-opcode and call graph report to FILE\n"
+              << "  --folded FILE             Write call stacks in folded format to FILE, for flame graphs\n"
+              << "  --break ADDR              Stop before executing ADDR\n"
+              << "  --watch RANGE             Stop after an instruction writes within RANGE\n"
+              << "  --watch-read RANGE        Stop after an instruction reads within RANGE\n"
+              << "  --debug                   Prompt for debugger commands at the start and at every stop\n"
+              << "Numbers are decimal, or hex with a $ or 0x prefix, and a RANGE is ADDR or ADDR-ADDR\n";
+}
+
+// Throws std::invalid_argument or std::out_of_range for bad numbers
+uint64_t parse_number(std::string text, uint64_t max) {
+    if (!text.empty() && text[0] == '$') text = "0x" + text.substr(1);
+    size_t end;
+    uint64_t value = std::stoull(text, &end, 0);
+    if (end != text.size()) throw std::invalid_argument("Not a number: " + text);
+    if (value > max) throw std::out_of_range("Out of range: " + text);
+    return value;
+}
+
+// Start and length of ADDR or the inclusive range ADDR-ADDR
+std::pair<uint16_t, uint32_t> parse_range(const std::string &text) {
+    size_t dash = text.find('-');
+    uint16_t start = parse_number(text.substr(0, dash), 0xFFFF);
+    if (dash == std::string::npos) return { start, 1 };
+    uint16_t end = parse_number(text.substr(dash + 1), 0xFFFF);
+    if (end < start) throw std::invalid_argument("Range ends before it starts: " + text);
+    return { start, end - start + 1u };
+}
+
+void debug_help() {
+    std::cout << "  c                     Continue\n"
+              << "  s [N]                 Step N instructions (default 1)\n"
+              << "  r                     Show registers\n"
+              << "  m RANGE               Show memory\n"
+              << "  d [ADDR] [N]          Disassemble N instructions (default 10) from ADDR (default PC)\n"
+              << "  b ADDR / bd ADDR      Set / delete a breakpoint\n"
+              << "  w RANGE [r|w|rw]      Set a watchpoint, on writes by default\n"
+              << "  wd RANGE              Delete the watchpoints in RANGE\n"
+              << "  q                     Quit\n";
+}
+
+void show_stop(CPU6502<PagedMemory> &cpu, PagedMemory &mem) {
+    std::cout << Debugger::registers_to_string(cpu.get_registers()) << '\n';
+    Debugger::print_disassembly(std::cout, mem, cpu.get_pc(), 1);
+}
+
+// Reads and runs commands until one continues the run, returns false to quit instead
+bool debug_prompt(CPU6502<PagedMemory> &cpu, PagedMemory &mem, Debugger &debugger) {
+    std::string line;
+    while (std::cout << "(6502) " << std::flush, std::getline(std::cin, line)) {
+        std::istringstream words(line);
+        std::string command, first, second;
+        words >> command >> first >> second;
+        try {
+            if (command.empty()) continue;
+            else if (command == "c") return true;
+            else if (command == "q") return false;
+            else if (command == "s") {
+                RunResult step = cpu.run_instructions(first.empty() ? 1 : parse_number(first, std::numeric_limits<uint64_t>::max()));
+                if (step.reason == StopReason::BREAKPOINT || step.reason == StopReason::WATCHPOINT) {
+                    std::cout << Debugger::to_string(debugger.event()) << '\n';
+                }
+                show_stop(cpu, mem);
+            }
+            else if (command == "r") std::cout << Debugger::registers_to_string(cpu.get_registers()) << '\n';
+            else if (command == "m") {
+                auto range = parse_range(first);
+                Debugger::print_memory(std::cout, mem, range.first, range.second);
+            }
+            else if (command == "d") {
+                uint16_t start = first.empty() ? cpu.get_pc() : parse_number(first, 0xFFFF);
+                Debugger::print_disassembly(std::cout, mem, start, second.empty() ? 10 : parse_number(second, 0x10000));
+            }
+            else if (command == "b") debugger.add_breakpoint(parse_number(first, 0xFFFF));
+            else if (command == "bd") debugger.remove_breakpoint(parse_number(first, 0xFFFF));
+            else if (command == "w") {
+                auto range = parse_range(first);
+                WatchKind kind = WatchKind::WRITE;
+                if (second == "r") kind = WatchKind::READ;
+                else if (second == "rw") kind = WatchKind::ACCESS;
+                else if (!second.empty() && second != "w") throw std::invalid_argument("Unknown access " + second);
+                debugger.add_watchpoint(range.first, range.second, kind);
+            }
+            else if (command == "wd") {
+                auto range = parse_range(first);
+                debugger.remove_watchpoint(range.first, range.second);
+            }
+            else debug_help();
+        } catch (const std::exception &e) {
+            std::cout << e.what() << '\n';
+        }
+    }
+    return false;
+}
+
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::string path = argv[1];
+    std::optional<ImageFormat> format;
+    uint16_t load_address = 0x600;
+    std::optional<uint16_t> reset, stop_pc, exit_address;
+    uint64_t cycle_limit = std::numeric_limits<uint64_t>::max();
+    bool stop_on_brk = true, block_cache = false, jit = false;
+    std::string profile_path, folded_path;
+    std::vector<uint16_t> breakpoints;
+    std::vector<std::pair<std::pair<uint16_t, uint32_t>, WatchKind>> watchpoints;
+    bool debug = false;
+
+    try {
+        for (int i = 2; i < argc; i++) {
+            std::string option = argv[i];
+            auto value = [&]() -> std::string {
+                if (i + 1 >= argc) throw std::invalid_argument("Missing value for " + option);
+                return argv[++i];
+            };
+
+            if (option == "--format") {
+                std::string name = value();
+                if (name == "raw") format = ImageFormat::RAW;
+                else if (name == "prg") format = ImageFormat::PRG;
+                else if (name == "hex") format = ImageFormat::INTEL_HEX;
+                else if (name == "seg") format = ImageFormat::SEGMENTED;
+                else if (name == "asm") format = ImageFormat::ASSEMBLY;
+                else throw std::invalid_argument("Unknown format " + name);
+            }
+            else if (option == "--load") load_address = parse_number(value(), 0xFFFF);
+            else if (option == "--reset") reset = parse_number(value(), 0xFFFF);
+            else if (option == "--pc") stop_pc = parse_number(value(), 0xFFFF);
+            else if (option == "--cycles") cycle_limit = parse_number(value(), std::numeric_limits<uint64_t>::max());
+            else if (option == "--exit") exit_address = parse_number(value(), 0xFFFF);
+            else if (option == "--no-brk") stop_on_brk = false;
+            else if (option == "--block-cache") block_cache = true;
+            else if (option == "--jit") jit = true;
+            else if (option == "--profile") profile_path = value();
+            else if (option == "--folded") folded_path = value();
+            else if (option == "--break") breakpoints.push_back(parse_number(value(), 0xFFFF));
+            else if (option == "--watch") watchpoints.push_back({ parse_range(value()), WatchKind::WRITE });
+            else if (option == "--watch-read") watchpoints.push_back({ parse_range(value()), WatchKind::READ });
+            else if (option == "--debug") debug = true;
+            else throw std::invalid_argument("Unknown option " + option);
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+        usage(argv[0]);
+        return 2;
+    }
+
+    auto mem = std::make_shared<PagedMemory>();
+    try {
+        ProgramImage image = format ? Loader::load(path, *format, load_address) : Loader::load(path, load_address);
+        image.load_into(*mem);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+        return 2;
+    }
+    if (reset) mem->write_word(RST_VEC, *reset);
+
+    CPU6502<PagedMemory> cpu(mem);
+    cpu.set_stop_on_brk(stop_on_brk);
+    cpu.set_block_cache(block_cache);
+    cpu.set_jit(jit);
+    cpu.set_stop_pc(stop_pc);
+
+    std::optional<uint8_t> exit_code;
+    if (exit_address) {
+        mem->map_io(*exit_address, nullptr, [&exit_code, &cpu](uint16_t, uint8_t data) {
+            exit_code = data;
+            cpu.request_stop();
+        });
+    }
+
+    std::shared_ptr<Profiler> profiler;
+    if (!profile_path.empty() || !folded_path.empty()) {
+#ifdef CPU6502_PROFILE
+        profiler = std::make_shared<Profiler>();
+        cpu.set_profiler(profiler);
+#else
+        std::cerr << "Profiling needs a build with CPU6502_PROFILE\n";
+        return 2;
+#endif
+    }
+
+    std::shared_ptr<Debugger> debugger;
+    if (debug || !breakpoints.empty() || !watchpoints.empty()) {
+        debugger = std::make_shared<Debugger>();
+        for (uint16_t addr : breakpoints) debugger->add_breakpoint(addr);
+        for (const auto &watch : watchpoints) debugger->add_watchpoint(watch.first.first, watch.first.second, watch.second);
+        cpu.set_debugger(debugger);
+    }
+    if (debug) {
+        show_stop(cpu, *mem);
+        if (!debug_prompt(cpu, *mem, *debugger)) return 0;
+    }
+
+    // The CPU stops for these itself, without giving up the block cache or the JIT
+    auto target_reached = [&cpu, &stop_pc, &exit_code] {
+        return exit_code || (stop_pc && cpu.get_pc() == *stop_pc);
+    };
+
+    RunResult result;
+    uint64_t cycles = 0;
+    double seconds = 0;
+    bool debugger_stop;
+    do {
+        auto start = std::chrono::steady_clock::now();
+        result = cpu.run_cycles(cycle_limit - cycles);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        cycles += result.cycles;
+
+        debugger_stop = result.reason == StopReason::WATCHPOINT
+            || (result.reason == StopReason::BREAKPOINT && debugger && !target_reached());
+        if (debugger_stop) {
+            std::cout << Debugger::to_string(debugger->event()) << '\n';
+            if (debug) show_stop(cpu, *mem);
+        }
+    } while (debugger_stop && debug && debug_prompt(cpu, *mem, *debugger));
+
+    const char *reason = "cycle limit";
+    switch (result.reason) {
+        case StopReason::BUDGET:     reason = "cycle limit"; break;
+        case StopReason::BRK:        reason = "BRK"; break;
+        case StopReason::BREAKPOINT: reason = debugger_stop ? "breakpoint" : exit_code ? "exit write" : "target PC"; break;
+        case StopReason::WATCHPOINT: reason = "watchpoint"; break;
+        case StopReason::HALT:       reason = "halted on illegal opcode"; break;
+    }
+
+    Registers regs = cpu.get_registers();
+    std::cout << "Stopped: " << reason << '\n'
+              << std::uppercase << std::hex << std::setfill('0')
+              << "PC=" << std::setw(4) << regs.PC
+              << " A=" << std::setw(2) << (int) regs.A
+              << " X=" << std::setw(2) << (int) regs.X
+              << " Y=" << std::setw(2) << (int) regs.Y
+              << " P=" << std::setw(2) << (int) regs.P
+              << " S=" << std::setw(2) << (int) regs.S << '\n'
+              << std::dec << std::setfill(' ')
+              << "Cycles: " << cycles << '\n'
+              << std::fixed << std::setprecision(6) << "Host time: " << seconds << " s\n"
+              << std::setprecision(2) << "Effective: " << (seconds > 0 ? cycles / seconds / 1e6 : 0) << " MHz\n";
+
+    if (profiler) {
+        if (!profile_path.empty()) {
+            std::ofstream out(profile_path);
+            profiler->print(out);
+        }
+        if (!folded_path.empty()) {
+            std::ofstream out(folded_path);
+            profiler->print_folded(out);
+        }
+    }
+
+    if (exit_code) return *exit_code;
+    return (result.reason == StopReason::HALT) ? 1 : 0;
+}
@@ -0,0 +1,930 @@
+#ifdef CPU6502_JIT
+
+#if !defined(__x86_64__) || !defined(__linux__)
+#error "CPU6502_JIT needs Linux on x86-64"
+#endif
+
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/mman.h>
+
+#include "instruction.h"
+#include "jit_x64.h"
+
+namespace {
+
+/*
+ * Minimal x86-64 assembler, covering the instruction forms the translator needs
+ */
+
+enum Reg { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+// Condition codes, as in the low nibble of Jcc and SETcc
+enum Cond { CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_A = 0x7 };
+
+// ALU operations with a register source, by opcode
+enum AluOp { ADD = 0x01, OR = 0x09, AND = 0x21, SUB = 0x29, XOR = 0x31, CMP = 0x39, TEST = 0x85 };
+
+// ALU operations with an immediate source, by ModRM reg field
+enum ImmOp { ADD_I = 0, OR_I = 1, AND_I = 4, SUB_I = 5, XOR_I = 6, CMP_I = 7 };
+
+// [base + index*(1 << scale) + disp]
+typedef struct Mem {
+    int base;
+    int index;
+    int scale;
+    int32_t disp;
+} Mem;
+
+Mem at(int base, int32_t disp=0) { return { base, -1, 0, disp }; }
+Mem at(int base, int index, int scale, int32_t disp=0) { return { base, index, scale, disp }; }
+
+typedef struct Label {
+    long pos = -1;
+    std::vector<size_t> fixups; // rel32 fields waiting for pos
+} Label;
+
+class Assembler {
+ public:
+    std::vector<uint8_t> code;
+
+    void mov(int dst, int src) { op_rr({ 0x89 }, src, dst); }
+    void mov64(int dst, int src) { op_rr({ 0x89 }, src, dst, true); }
+    void mov_imm(int dst, uint32_t imm) {
+        if (dst >= 8) byte(0x41);
+        byte(0xB8 | (dst & 7));
+        dword(imm);
+    }
+
+    void load8(int dst, Mem m) { op_mem({ 0x0F, 0xB6 }, dst, m); } // Zero-extended
+    void load64(int dst, Mem m) { op_mem({ 0x8B }, dst, m, true); }
+    void store8(Mem m, int src) { op_mem({ 0x88 }, src, m, false, src); }
+    void store16(Mem m, int src) { op_mem({ 0x89 }, src, m, false, -1, true); }
+    void store16_imm(Mem m, uint16_t imm) {
+        op_mem({ 0xC7 }, 0, m, false, -1, true);
+        byte(imm);
+        byte(imm >> 8);
+    }
+    void store64(Mem m, int src) { op_mem({ 0x89 }, src, m, true); }
+    void lea(int dst, Mem m, bool wide=false) { op_mem({ 0x8D }, dst, m, wide); }
+
+    void alu(AluOp op, int dst, int src, bool wide=false) { op_rr({ (uint8_t) op }, src, dst, wide); }
+    void alu_imm(ImmOp op, int dst, uint32_t imm, bool wide=false) {
+        op_rr({ 0x81 }, op, dst, wide);
+        dword(imm);
+    }
+    void test_imm(int dst, uint32_t imm) {
+        op_rr({ 0xF7 }, 0, dst);
+        dword(imm);
+    }
+    void cmp8_imm(Mem m, uint8_t imm) {
+        op_mem({ 0x80 }, CMP_I, m);
+        byte(imm);
+    }
+    void cmp64(int reg, Mem m) { op_mem({ 0x3B }, reg, m, true); }
+    void shl(int dst, uint8_t count) { op_rr({ 0xC1 }, 4, dst); byte(count); }
+    void shr(int dst, uint8_t count) { op_rr({ 0xC1 }, 5, dst); byte(count); }
+    void setcc(Cond cc, int dst) { op_rr({ 0x0F, (uint8_t) (0x90 | cc) }, 0, dst, false, dst); }
+    void movzx8(int dst, int src) { op_rr({ 0x0F, 0xB6 }, dst, src, false, src); }
+
+    void push(int reg) {
+        if (reg >= 8) byte(0x41);
+        byte(0x50 | (reg & 7));
+    }
+    void pop(int reg) {
+        if (reg >= 8) byte(0x41);
+        byte(0x58 | (reg & 7));
+    }
+    void ret() { byte(0xC3); }
+
+    void jcc(Cond cc, Label &label) {
+        byte(0x0F);
+        byte(0x80 | cc);
+        rel32(label);
+    }
+    void jmp(Label &label) {
+        byte(0xE9);
+        rel32(label);
+    }
+    void bind(Label &label) {
+        label.pos = code.size();
+        for (size_t fixup : label.fixups) patch(fixup, label.pos);
+        label.fixups.clear();
+    }
+
+ private:
+    void byte(uint8_t b) { code.push_back(b); }
+    void dword(uint32_t d) {
+        for (int i = 0; i < 4; i++) byte(d >> 8*i);
+    }
+
+    // byte_reg is a register used as a byte operand, for which SPL..DIL need a REX prefix
+    void rex(bool wide, int reg, int index, int base, int byte_reg) {
+        uint8_t prefix = 0x40 | (wide << 3) | ((reg >= 8) << 2) | ((index >= 8) << 1) | (base >= 8);
+        if (prefix != 0x40 || (byte_reg >= 4 && byte_reg < 8)) byte(prefix);
+    }
+
+    void op_rr(std::initializer_list<uint8_t> opcode, int reg, int rm, bool wide=false, int byte_reg=-1) {
+        rex(wide, reg, 0, rm, byte_reg);
+        for (uint8_t b : opcode) byte(b);
+        byte(0xC0 | (reg & 7) << 3 | (rm & 7));
+    }
+
+    // Always uses a 32-bit displacement, which also avoids the special cases of RBP and R13
+    void op_mem(std::initializer_list<uint8_t> opcode, int reg, Mem m, bool wide=false, int byte_reg=-1, bool word=false) {
+        if (word) byte(0x66);
+        rex(wide, reg, m.index < 0 ? 0 : m.index, m.base, byte_reg);
+        for (uint8_t b : opcode) byte(b);
+        if (m.index < 0 && (m.base & 7) != RSP) {
+            byte(0x80 | (reg & 7) << 3 | (m.base & 7));
+        }
+        else {
+            byte(0x80 | (reg & 7) << 3 | RSP);
+            int index = m.index < 0 ? RSP : m.index; // RSP as the index means none
+            byte(m.scale << 6 | (index & 7) << 3 | (m.base & 7));
+        }
+        dword(m.disp);
+    }
+
+    void rel32(Label &label) {
+        size_t fixup = code.size();
+        dword(0);
+        if (label.pos >= 0) patch(fixup, label.pos);
+        else label.fixups.push_back(fixup);
+    }
+
+    void patch(size_t fixup, size_t target) {
+        uint32_t rel = target - (fixup + 4);
+        std::memcpy(&code[fixup], &rel, 4);
+    }
+};
+
+/*
+ * Decoding
+ */
+
+// Flags tracked by liveness, as P bits
+const uint8_t FLAG_N = 0x80, FLAG_V = 0x40, FLAG_Z = 0x02, FLAG_C = 0x01;
+const uint8_t ALL_FLAGS = FLAG_N | FLAG_V | FLAG_Z | FLAG_C;
+
+typedef struct Decoded {
+    uint16_t pc;
+    Op op;
+    Mode mode;
+    uint16_t operand;
+    uint8_t length;   // Operand bytes
+    uint8_t cycles;   // Base cycle count
+    uint8_t live_out; // Flags observed after this instruction
+} Decoded;
+
+bool translatable(Op op, Mode mode) {
+    switch (op) {
+        case Op::BRK: case Op::RTI: case Op::PLP: case Op::SED: case Op::CLD: case Op::ILLEGAL:
+            return false;
+        case Op::JMP:
+            return mode == Mode::ABS;
+        default:
+            return true;
+    }
+}
+
+bool is_branch(Op op) {
+    switch (op) {
+        case Op::BCC: case Op::BCS: case Op::BEQ: case Op::BNE:
+        case Op::BMI: case Op::BPL: case Op::BVC: case Op::BVS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool ends_block(Op op) {
+    return is_branch(op) || op == Op::JMP || op == Op::JSR || op == Op::RTS;
+}
+
+// Instructions that only read their operand, and so take a cycle longer when indexing crosses a page
+bool reads_only(Op op) {
+    switch (op) {
+        case Op::ADC: case Op::AND: case Op::CMP: case Op::EOR: case Op::LDA:
+        case Op::LDX: case Op::LDY: case Op::ORA: case Op::SBC:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool has_penalty(const Decoded &d) {
+    return reads_only(d.op) && (d.mode == Mode::ABX || d.mode == Mode::ABY || d.mode == Mode::INY);
+}
+
+// Whether translated code may hand back to the interpreter before this instruction,
+// at which point all flags must be up to date
+bool may_exit(const Decoded &d) {
+    switch (d.op) {
+        case Op::PHA: case Op::PHP: case Op::PLA: case Op::JSR: case Op::RTS:
+            return true;
+        default:
+            return d.mode != Mode::IMP && d.mode != Mode::ACC && d.mode != Mode::IMM && d.mode != Mode::REL;
+    }
+}
+
+uint8_t flags_read(Op op) {
+    switch (op) {
+        case Op::ADC: case Op::SBC: case Op::ROL: case Op::ROR: case Op::BCC: case Op::BCS:
+            return FLAG_C;
+        case Op::BEQ: case Op::BNE:
+            return FLAG_Z;
+        case Op::BMI: case Op::BPL:
+            return FLAG_N;
+        case Op::BVC: case Op::BVS:
+            return FLAG_V;
+        case Op::PHP:
+            return ALL_FLAGS;
+        default:
+            return 0;
+    }
+}
+
+uint8_t flags_written(Op op) {
+    switch (op) {
+        case Op::ADC: case Op::SBC:
+            return ALL_FLAGS;
+        case Op::BIT:
+            return FLAG_N | FLAG_V | FLAG_Z;
+        case Op::ASL: case Op::LSR: case Op::ROL: case Op::ROR: case Op::CMP: case Op::CPX: case Op::CPY:
+            return FLAG_N | FLAG_Z | FLAG_C;
+        case Op::AND: case Op::ORA: case Op::EOR: case Op::LDA: case Op::LDX: case Op::LDY:
+        case Op::INC: case Op::DEC: case Op::INX: case Op::INY: case Op::DEX: case Op::DEY:
+        case Op::TAX: case Op::TAY: case Op::TXA: case Op::TYA: case Op::TSX: case Op::PLA:
+            return FLAG_N | FLAG_Z;
+        case Op::CLC: case Op::SEC:
+            return FLAG_C;
+        case Op::CLV:
+            return FLAG_V;
+        default:
+            return 0;
+    }
+}
+
+/*
+ * Translation
+ *
+ * Register use in translated code:
+ *  RBX: JitState*            RBP: PageTable*          R10: code map
+ *  R12: A    R13: X    R14: Y    R15: P, each zero-extended
+ *  R11: cycles used so far, less the base cycles of the current pass through the block
+ *  R9:  extra cycle of the current instruction for crossing a page
+ *  Everything else is scratch
+ */
+
+const int32_t READ_PAGES = offsetof(PageTable, read);
+const int32_t WRITE_PAGES = offsetof(PageTable, write);
+const int32_t IO_PAGES = offsetof(PageTable, io);
+const int32_t MIXED_READ = offsetof(MixedPage, read);
+const int32_t MIXED_WRITE = offsetof(MixedPage, write);
+const int32_t MIXED_IO = offsetof(MixedPage, io);
+
+class Translator {
+ public:
+    Translator(const std::vector<Decoded> &block) : block{block}, exits(block.size()) {
+        uint32_t cycles = 0;
+        for (const Decoded &d : block) {
+            prefix_cycles.push_back(cycles);
+            cycles += d.cycles;
+            worst_cycles += d.cycles + has_penalty(d);
+        }
+        total_cycles = cycles;
+        if (is_branch(block.back().op)) worst_cycles += 2;
+    }
+
+    std::vector<uint8_t> translate();
+    uint32_t worst() const { return worst_cycles; }
+
+ private:
+    const std::vector<Decoded> &block;
+    Assembler a;
+    Label top, epilogue;
+    std::vector<Label> exits; // Back to the interpreter, before each instruction
+    std::vector<uint32_t> prefix_cycles;
+    uint32_t total_cycles;
+    uint32_t worst_cycles = 0;
+
+    void prologue();
+    void instruction(size_t i);
+    void finish(uint16_t pc, uint32_t extra_cycles=0);
+
+    // Addressing, leaving a dynamic address in ECX
+    bool address(const Decoded &d, Label &exit, uint16_t &addr);
+    void read(bool fixed, uint16_t addr, Label &exit);        // Into EDX
+    void check_write(bool fixed, uint16_t addr, Label &exit); // Page pointer into R8
+    void write(bool fixed, uint16_t addr);                    // From EDX, after check_write
+    void load_operand(const Decoded &d, Label &exit);
+    void mixed_page(bool fixed, uint16_t addr, int32_t field, int dst, Label &exit); // Uses RSI and RDI
+
+    void stack_page(Label &exit, bool writing);
+    void step_stack(bool up);
+
+    void set_nz(int reg, uint8_t live);
+    void set_flag(uint8_t flag, int value_reg);
+    void add_with_carry(uint8_t live);
+    void compare(int reg, uint8_t live);
+    void shift(Op op, int reg, uint8_t live);
+};
+
+std::vector<uint8_t> Translator::translate() {
+    prologue();
+    a.bind(top);
+    for (size_t i = 0; i < block.size(); i++) instruction(i);
+    if (!ends_block(block.back().op)) {
+        const Decoded &last = block.back();
+        finish(last.pc + last.length + 1);
+    }
+
+    a.bind(epilogue);
+    a.store8(at(RBX, offsetof(JitState, A)), R12);
+    a.store8(at(RBX, offsetof(JitState, X)), R13);
+    a.store8(at(RBX, offsetof(JitState, Y)), R14);
+    a.store8(at(RBX, offsetof(JitState, P)), R15);
+    a.store64(at(RBX, offsetof(JitState, cycles)), R11);
+    for (int reg : { R15, R14, R13, R12, RBP, RBX }) a.pop(reg);
+    a.ret();
+
+    for (size_t i = 0; i < block.size(); i++) {
+        if (exits[i].fixups.empty()) continue;
+        a.bind(exits[i]);
+        if (prefix_cycles[i]) a.alu_imm(ADD_I, R11, prefix_cycles[i], true);
+        a.store16_imm(at(RBX, offsetof(JitState, PC)), block[i].pc);
+        a.jmp(epilogue);
+    }
+    return a.code;
+}
+
+void Translator::prologue() {
+    for (int reg : { RBX, RBP, R12, R13, R14, R15 }) a.push(reg);
+    a.mov64(RBX, RDI);
+    a.load64(RBP, at(RBX, offsetof(JitState, pages)));
+    a.load64(R10, at(RBX, offsetof(JitState, code_map)));
+    a.load8(R12, at(RBX, offsetof(JitState, A)));
+    a.load8(R13, at(RBX, offsetof(JitState, X)));
+    a.load8(R14, at(RBX, offsetof(JitState, Y)));
+    a.load8(R15, at(RBX, offsetof(JitState, P)));
+    a.alu(XOR, R11, R11);
+}
+
+// Leaves the block for pc, looping instead when that is the start of the block and the budget allows
+void Translator::finish(uint16_t pc, uint32_t extra_cycles) {
+    a.alu_imm(ADD_I, R11, total_cycles + extra_cycles, true);
+    if (pc == block.front().pc) {
+        Label leave;
+        a.lea(RAX, at(R11, worst_cycles), true);
+        a.cmp64(RAX, at(RBX, offsetof(JitState, budget)));
+        a.jcc(CC_A, leave);
+        a.jmp(top);
+        a.bind(leave);
+    }
+    a.store16_imm(at(RBX, offsetof(JitState, PC)), pc);
+    a.jmp(epilogue);
+}
+
+// Returns whether the address is known at translation time, in which case it is put in addr
+bool Translator::address(const Decoded &d, Label &exit, uint16_t &addr) {
+    bool penalty = has_penalty(d);
+    switch (d.mode) {
+        case Mode::ZER:
+        case Mode::ABS:
+            addr = d.operand;
+            return true;
+        case Mode::ZEX:
+        case Mode::ZEY:
+            a.lea(RCX, at(d.mode == Mode::ZEX ? R13 : R14, d.operand));
+            a.alu_imm(AND_I, RCX, 0xFF);
+            return false;
+        case Mode::ABX:
+        case Mode::ABY: {
+            int index = d.mode == Mode::ABX ? R13 : R14;
+            a.lea(RCX, at(index, d.operand));
+            a.alu_imm(AND_I, RCX, 0xFFFF);
+            if (penalty) {
+                a.lea(R9, at(index, d.operand & 0xFF));
+                a.shr(R9, 8);
+            }
+            return false;
+        }
+        // The pointer bytes are read like any other operand, since the zero page may hold I/O
+        case Mode::INX:
+            a.lea(RCX, at(R13, d.operand));
+            a.alu_imm(AND_I, RCX, 0xFF);
+            read(false, 0, exit);
+            a.mov(R8, RDX);
+            a.lea(RCX, at(R13, d.operand + 1));
+            a.alu_imm(AND_I, RCX, 0xFF);
+            read(false, 0, exit);
+            a.shl(RDX, 8);
+            a.alu(OR, RDX, R8);
+            a.mov(RCX, RDX);
+            return false;
+        case Mode::INY:
+            read(true, d.operand, exit);
+            a.mov(R8, RDX);
+            read(true, (d.operand + 1) & 0xFF, exit);
+            a.shl(RDX, 8);
+            a.alu(OR, RDX, R8);
+            a.mov(RCX, RDX);
+            if (penalty) {
+                a.movzx8(R9, RCX);
+                a.alu(ADD, R9, R14);
+                a.shr(R9, 8);
+            }
+            a.alu(ADD, RCX, R14);
+            a.alu_imm(AND_I, RCX, 0xFFFF);
+            return false;
+        default:
+            throw std::logic_error("No address for addressing mode");
+    }
+}
+
+void Translator::read(bool fixed, uint16_t addr, Label &exit) {
+    Label direct;
+    if (fixed) {
+        a.load64(RAX, at(RBP, READ_PAGES + (addr >> 8) * 8));
+        a.alu(TEST, RAX, RAX, true);
+        a.jcc(CC_NE, direct);
+        mixed_page(fixed, addr, MIXED_READ, RAX, exit);
+        a.bind(direct);
+        a.load8(RDX, at(RAX, addr & 0xFF));
+    }
+    else {
+        a.mov(RAX, RCX);
+        a.shr(RAX, 8);
+        a.load64(RAX, at(RBP, RAX, 3, READ_PAGES));
+        a.alu(TEST, RAX, RAX, true);
+        a.jcc(CC_NE, direct);
+        mixed_page(fixed, addr, MIXED_READ, RAX, exit);
+        a.bind(direct);
+        a.movzx8(RSI, RCX);
+        a.load8(RDX, at(RAX, RSI, 0));
+    }
+}
+
+// Stores to translated code, and to addresses without a direct pointer, are left to the interpreter
+void Translator::check_write(bool fixed, uint16_t addr, Label &exit) {
+    Label direct;
+    if (fixed) {
+        a.cmp8_imm(at(R10, addr), 0);
+        a.jcc(CC_NE, exit);
+        a.load64(R8, at(RBP, WRITE_PAGES + (addr >> 8) * 8));
+    }
+    else {
+        a.cmp8_imm(at(R10, RCX, 0), 0);
+        a.jcc(CC_NE, exit);
+        a.mov(RDI, RCX);
+        a.shr(RDI, 8);
+        a.load64(R8, at(RBP, RDI, 3, WRITE_PAGES));
+    }
+    a.alu(TEST, R8, R8, true);
+    a.jcc(CC_NE, direct);
+    mixed_page(fixed, addr, MIXED_WRITE, R8, exit);
+    a.bind(direct);
+}
+
+// For an address, fixed or in ECX, whose page has no direct pointer, loads dst from a field of the page's MixedPage,
+// exiting if the page has none, the address is mapped to I/O, or the pointer is null
+void Translator::mixed_page(bool fixed, uint16_t addr, int32_t field, int dst, Label &exit) {
+    if (fixed) {
+        a.load64(RSI, at(RBP, IO_PAGES + (addr >> 8) * 8));
+        a.alu(TEST, RSI, RSI, true);
+        a.jcc(CC_E, exit);
+        a.cmp8_imm(at(RSI, MIXED_IO + (addr & 0xFF)), 0);
+    }
+    else {
+        a.mov(RDI, RCX);
+        a.shr(RDI, 8);
+        a.load64(RSI, at(RBP, RDI, 3, IO_PAGES));
+        a.alu(TEST, RSI, RSI, true);
+        a.jcc(CC_E, exit);
+        a.movzx8(RDI, RCX);
+        a.cmp8_imm(at(RSI, RDI, 0, MIXED_IO), 0);
+    }
+    a.jcc(CC_NE, exit);
+    a.load64(dst, at(RSI, field));
+    a.alu(TEST, dst, dst, true);
+    a.jcc(CC_E, exit);
+}
+
+void Translator::write(bool fixed, uint16_t addr) {
+    if (fixed) {
+        a.store8(at(R8, addr & 0xFF), RDX);
+    }
+    else {
+        a.movzx8(RSI, RCX);
+        a.store8(at(R8, RSI, 0), RDX);
+    }
+}
+
+void Translator::load_operand(const Decoded &d, Label &exit) {
+    if (d.mode == Mode::IMM) {
+        a.mov_imm(RDX, d.operand);
+        return;
+    }
+    uint16_t addr = 0;
+    bool fixed = address(d, exit, addr);
+    read(fixed, addr, exit);
+}
+
+// Leaves S in ESI and the stack page's pointer in RAX for reads, or R8 for writes
+void Translator::stack_page(Label &exit, bool writing) {
+    if (writing) {
+        a.load64(R8, at(RBP, WRITE_PAGES + 8));
+        a.alu(TEST, R8, R8, true);
+        a.jcc(CC_E, exit);
+    }
+    else {
+        a.load64(RAX, at(RBP, READ_PAGES + 8));
+        a.alu(TEST, RAX, RAX, true);
+        a.jcc(CC_E, exit);
+    }
+    a.load8(RSI, at(RBX, offsetof(JitState, S)));
+}
+
+void Translator::step_stack(bool up) {
+    a.lea(RSI, at(RSI, up ? 1 : -1));
+    a.alu_imm(AND_I, RSI, 0xFF);
+}
+
+void Translator::set_nz(int reg, uint8_t live) {
+    uint8_t mask = live & (FLAG_N | FLAG_Z);
+    if (!mask) return;
+
+    a.alu_imm(AND_I, R15, ~mask & 0xFF);
+    if (mask & FLAG_N) {
+        a.mov(RAX, reg);
+        a.alu_imm(AND_I, RAX, FLAG_N);
+        a.alu(OR, R15, RAX);
+    }
+    if (mask & FLAG_Z) {
+        a.alu(TEST, reg, reg);
+        a.setcc(CC_E, RAX);
+        a.movzx8(RAX, RAX);
+        a.shl(RAX, 1);
+        a.alu(OR, R15, RAX);
+    }
+}
+
+// value_reg holds 0 or 1
+void Translator::set_flag(uint8_t flag, int value_reg) {
+    a.alu_imm(AND_I, R15, ~flag & 0xFF);
+    int shift = 0;
+    while ((1 << shift) != flag) shift++;
+    if (shift) a.shl(value_reg, shift);
+    a.alu(OR, R15, value_reg);
+}
+
+// A + EDX + C, as for binary ADC. SBC is the same with the operand inverted
+void Translator::add_with_carry(uint8_t live) {
+    a.mov(RAX, R15);
+    a.alu_imm(AND_I, RAX, FLAG_C);
+    a.mov(RCX, R12);
+    a.alu(ADD, RCX, RDX);
+    a.alu(ADD, RCX, RAX);
+    if (live & FLAG_V) {
+        // Overflow when both inputs have the same sign, and the result's differs
+        a.mov(RAX, R12);
+        a.alu(XOR, RAX, RDX);
+        a.alu_imm(XOR_I, RAX, 0x80);
+        a.mov(RDI, R12);
+        a.alu(XOR, RDI, RCX);
+        a.alu(AND, RAX, RDI);
+        a.shr(RAX, 7);
+        a.alu_imm(AND_I, RAX, 1);
+        set_flag(FLAG_V, RAX);
+    }
+    if (live & FLAG_C) {
+        a.mov(RAX, RCX);
+        a.shr(RAX, 8);
+        set_flag(FLAG_C, RAX);
+    }
+    a.alu_imm(AND_I, RCX, 0xFF);
+    a.mov(R12, RCX);
+    set_nz(R12, live);
+}
+
+void Translator::compare(int reg, uint8_t live) {
+    if (live & FLAG_C) {
+        a.alu(CMP, reg, RDX);
+        a.setcc(CC_AE, RAX);
+        a.movzx8(RAX, RAX);
+        set_flag(FLAG_C, RAX);
+    }
+    if (live & (FLAG_N | FLAG_Z)) {
+        a.mov(RCX, reg);
+        a.alu(SUB, RCX, RDX);
+        a.alu_imm(AND_I, RCX, 0xFF);
+        set_nz(RCX, live);
+    }
+}
+
+// Shifts or rotates reg, using RAX and RDI
+void Translator::shift(Op op, int reg, uint8_t live) {
+    if (op == Op::ROL || op == Op::ROR) {
+        a.mov(RDI, R15);
+        a.alu_imm(AND_I, RDI, FLAG_C);
+    }
+    a.mov(RAX, reg);
+    if (op == Op::ASL || op == Op::ROL) {
+        a.shr(RAX, 7);
+        a.shl(reg, 1);
+        if (op == Op::ROL) a.alu(OR, reg, RDI);
+        a.alu_imm(AND_I, reg, 0xFF);
+    }
+    else {
+        a.alu_imm(AND_I, RAX, 1);
+        a.shr(reg, 1);
+        if (op == Op::ROR) {
+            a.shl(RDI, 7);
+            a.alu(OR, reg, RDI);
+        }
+    }
+    if (live & FLAG_C) set_flag(FLAG_C, RAX);
+    set_nz(reg, live);
+}
+
+void Translator::instruction(size_t i) {
+    const Decoded &d = block[i];
+    Label &exit = exits[i];
+    uint8_t live = d.live_out & flags_written(d.op);
+    bool penalty = has_penalty(d);
+
+    switch (d.op) {
+        case Op::LDA: case Op::LDX: case Op::LDY: {
+            int reg = d.op == Op::LDA ? R12 : d.op == Op::LDX ? R13 : R14;
+            load_operand(d, exit);
+            a.mov(reg, RDX);
+            set_nz(reg, live);
+            break;
+        }
+        case Op::AND: case Op::ORA: case Op::EOR:
+            load_operand(d, exit);
+            a.alu(d.op == Op::AND ? AND : d.op == Op::ORA ? OR : XOR, R12, RDX);
+            set_nz(R12, live);
+            break;
+        case Op::ADC:
+            load_operand(d, exit);
+            add_with_carry(live);
+            break;
+        case Op::SBC:
+            load_operand(d, exit);
+            a.alu_imm(XOR_I, RDX, 0xFF);
+            add_with_carry(live);
+            break;
+        case Op::CMP: case Op::CPX: case Op::CPY:
+            load_operand(d, exit);
+            compare(d.op == Op::CMP ? R12 : d.op == Op::CPX ? R13 : R14, live);
+            break;
+        case Op::BIT: {
+            load_operand(d, exit);
+            uint8_t nv = live & (FLAG_N | FLAG_V);
+            if (nv) {
+                a.alu_imm(AND_I, R15, ~nv & 0xFF);
+                a.mov(RAX, RDX);
+                a.alu_imm(AND_I, RAX, nv);
+                a.alu(OR, R15, RAX);
+            }
+            a.mov(RCX, RDX);
+            a.alu(AND, RCX, R12);
+            set_nz(RCX, live & FLAG_Z);
+            break;
+        }
+        case Op::STA: case Op::STX: case Op::STY: {
+            uint16_t addr = 0;
+            bool fixed = address(d, exit, addr);
+            check_write(fixed, addr, exit);
+            a.mov(RDX, d.op == Op::STA ? R12 : d.op == Op::STX ? R13 : R14);
+            write(fixed, addr);
+            break;
+        }
+        case Op::ASL: case Op::LSR: case Op::ROL: case Op::ROR: case Op::INC: case Op::DEC: {
+            if (d.mode == Mode::ACC) {
+                shift(d.op, R12, live);
+                break;
+            }
+            // Both directions are checked before anything is modified
+            uint16_t addr = 0;
+            bool fixed = address(d, exit, addr);
+            read(fixed, addr, exit);
+            check_write(fixed, addr, exit);
+            if (d.op == Op::INC || d.op == Op::DEC) {
+                a.alu_imm(d.op == Op::INC ? ADD_I : SUB_I, RDX, 1);
+                a.alu_imm(AND_I, RDX, 0xFF);
+                set_nz(RDX, live);
+            }
+            else {
+                shift(d.op, RDX, live);
+            }
+            write(fixed, addr);
+            break;
+        }
+        case Op::INX: case Op::INY: case Op::DEX: case Op::DEY: {
+            int reg = (d.op == Op::INX || d.op == Op::DEX) ? R13 : R14;
+            a.alu_imm((d.op == Op::INX || d.op == Op::INY) ? ADD_I : SUB_I, reg, 1);
+            a.alu_imm(AND_I, reg, 0xFF);
+            set_nz(reg, live);
+            break;
+        }
+        case Op::TAX: a.mov(R13, R12); set_nz(R13, live); break;
+        case Op::TAY: a.mov(R14, R12); set_nz(R14, live); break;
+        case Op::TXA: a.mov(R12, R13); set_nz(R12, live); break;
+        case Op::TYA: a.mov(R12, R14); set_nz(R12, live); break;
+        case Op::TSX: a.load8(R13, at(RBX, offsetof(JitState, S))); set_nz(R13, live); break;
+        case Op::TXS: a.store8(at(RBX, offsetof(JitState, S)), R13); break;
+        case Op::CLC: if (live) a.alu_imm(AND_I, R15, ~FLAG_C & 0xFF); break;
+        case Op::SEC: if (live) a.alu_imm(OR_I, R15, FLAG_C); break;
+        case Op::CLV: if (live) a.alu_imm(AND_I, R15, ~FLAG_V & 0xFF); break;
+        case Op::CLI: a.alu_imm(AND_I, R15, ~0x04 & 0xFF); break;
+        case Op::SEI: a.alu_imm(OR_I, R15, 0x04); break;
+        case Op::NOP: break;
+        case Op::PHA: case Op::PHP:
+            stack_page(exit, true);
+            a.cmp8_imm(at(R10, RSI, 0, 0x100), 0);
+            a.jcc(CC_NE, exit);
+            a.mov(RDX, d.op == Op::PHA ? R12 : R15);
+            if (d.op == Op::PHP) a.alu_imm(OR_I, RDX, 0x30); // B and the unused bit
+            a.store8(at(R8, RSI, 0), RDX);
+            step_stack(false);
+            a.store8(at(RBX, offsetof(JitState, S)), RSI);
+            break;
+        case Op::PLA:
+            stack_page(exit, false);
+            step_stack(true);
+            a.load8(R12, at(RAX, RSI, 0));
+            a.store8(at(RBX, offsetof(JitState, S)), RSI);
+            set_nz(R12, live);
+            break;
+        case Op::JSR: {
+            // Pushes the address of the last byte of JSR, high byte first
+            uint16_t ret = d.pc + 2;
+            stack_page(exit, true);
+            a.cmp8_imm(at(R10, RSI, 0, 0x100), 0);
+            a.jcc(CC_NE, exit);
+            a.mov(RDI, RSI);
+            a.lea(RDI, at(RDI, -1));
+            a.alu_imm(AND_I, RDI, 0xFF);
+            a.cmp8_imm(at(R10, RDI, 0, 0x100), 0);
+            a.jcc(CC_NE, exit);
+            a.mov_imm(RDX, ret >> 8);
+            a.store8(at(R8, RSI, 0), RDX);
+            a.mov_imm(RDX, ret & 0xFF);
+            a.store8(at(R8, RDI, 0), RDX);
+            a.lea(RSI, at(RDI, -1));
+            a.alu_imm(AND_I, RSI, 0xFF);
+            a.store8(at(RBX, offsetof(JitState, S)), RSI);
+            finish(d.operand);
+            break;
+        }
+        case Op::RTS:
+            stack_page(exit, false);
+            step_stack(true);
+            a.load8(RCX, at(RAX, RSI, 0));
+            step_stack(true);
+            a.load8(RDX, at(RAX, RSI, 0));
+            a.store8(at(RBX, offsetof(JitState, S)), RSI);
+            a.shl(RDX, 8);
+            a.alu(OR, RCX, RDX);
+            a.lea(RCX, at(RCX, 1));
+            a.alu_imm(AND_I, RCX, 0xFFFF);
+            a.alu_imm(ADD_I, R11, total_cycles, true);
+            a.store16(at(RBX, offsetof(JitState, PC)), RCX);
+            a.jmp(epilogue);
+            break;
+        case Op::JMP:
+            finish(d.operand);
+            break;
+        case Op::BCC: case Op::BCS: case Op::BEQ: case Op::BNE:
+        case Op::BMI: case Op::BPL: case Op::BVC: case Op::BVS: {
+            uint8_t flag = flags_read(d.op);
+            bool taken_if_set = d.op == Op::BCS || d.op == Op::BEQ || d.op == Op::BMI || d.op == Op::BVS;
+            uint16_t next = d.pc + 2;
+            uint16_t target = next + (int8_t) d.operand;
+            // A taken branch costs one more cycle, or two if the target is on another page
+            uint32_t extra = ((next ^ target) & 0xFF00) ? 2 : 1;
+
+            Label taken;
+            a.test_imm(R15, flag);
+            a.jcc(taken_if_set ? CC_NE : CC_E, taken);
+            finish(next);
+            a.bind(taken);
+            finish(target, extra);
+            break;
+        }
+        default:
+            throw std::logic_error("Untranslatable instruction in block");
+    }
+
+    if (penalty) a.alu(ADD, R11, R9, true);
+}
+
+} // namespace
+
+JitX64::JitX64(size_t code_size) : code_size{code_size} {
+    if (code_size < max_code_length) throw std::invalid_argument("Code buffer is too small for a block");
+    void *buffer = mmap(nullptr, code_size, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer == MAP_FAILED) throw std::runtime_error("Could not map memory for translated code");
+    code_buffer = static_cast<uint8_t*>(buffer);
+}
+
+JitX64::~JitX64() {
+    munmap(code_buffer, code_size);
+}
+
+bool JitX64::execute(JitState &state) {
+    // Decimal mode ADC and SBC are left to the interpreter
+    if (state.P & 0x08) return false;
+
+    std::unique_ptr<EntryPage> &page = entries[state.PC >> 8];
+    if (!page) page = std::make_unique<EntryPage>();
+    Entry &entry = (*page)[state.PC & 0xFF];
+
+    if (!entry.code) {
+        if (entry.failed || ++entry.hits < hot_threshold) return false;
+        if (code_used + max_code_length > code_size) {
+            // Out of room, so start over, and translate whatever becomes hot again
+            flush();
+            return false;
+        }
+        if (!translate(state, entry)) return false;
+    }
+    if (entry.worst_cycles > state.budget) return false;
+
+    state.cycles = 0;
+    entry.code(&state);
+    return true;
+}
+
+void JitX64::invalidate_page(uint8_t page) {
+    entries[page].reset();
+}
+
+void JitX64::flush() {
+    for (auto &page : entries) page.reset();
+    code_used = 0;
+}
+
+bool JitX64::translate(const JitState &state, Entry &entry) {
+    uint16_t start = state.PC;
+    const uint8_t *page = state.pages->read[start >> 8];
+    if (!page) {
+        entry.failed = true;
+        return false;
+    }
+
+    std::vector<Decoded> block;
+    for (int offset = start & 0xFF; offset < 0x100; ) {
+        uint8_t opcode = page[offset];
+        const InstrInfo &info = Instructions::info[opcode];
+        uint8_t length = info.length;
+        uint16_t pc = (start & 0xFF00) | offset;
+        if (!translatable(info.op, info.mode) || offset + length > 0xFF || block.size() == max_block_length) break;
+        // The CPU stops before ever entering a block at the stop PC
+        if (pc == state.stop_pc && !block.empty()) break;
+
+        uint16_t operand = (length == 0) ? 0 : (length == 1) ? page[offset+1] : page[offset+1] | (page[offset+2] << 8);
+        block.push_back({ pc, info.op, info.mode, operand, length, info.cycles, 0 });
+        offset += length + 1;
+        if (ends_block(info.op)) break;
+    }
+
+    // Mark the code, so that overwriting it drops the translation, or lets a failed one be retried
+    uint16_t end = block.empty() ? start + 1 : block.back().pc + block.back().length + 1;
+    for (uint16_t addr = start; addr != end; addr++) state.code_map[addr] = 1;
+
+    if (block.empty()) {
+        entry.failed = true;
+        return false;
+    }
+
+    // Flags are live at the end of the block, and wherever translated code may return to the interpreter
+    uint8_t live = ALL_FLAGS;
+    for (auto it = block.rbegin(); it != block.rend(); ++it) {
+        it->live_out = live;
+        live = (live & ~flags_written(it->op)) | flags_read(it->op);
+        if (may_exit(*it)) live = ALL_FLAGS;
+    }
+
+    Translator translator(block);
+    std::vector<uint8_t> code = translator.translate();
+    if (code.size() > max_code_length) throw std::logic_error("Translated block is too long");
+
+    mprotect(code_buffer, code_size, PROT_READ | PROT_WRITE);
+    std::memcpy(code_buffer + code_used, code.data(), code.size());
+    mprotect(code_buffer, code_size, PROT_READ | PROT_EXEC);
+
+    entry.code = reinterpret_cast<block_fn_t>(code_buffer + code_used);
+    entry.worst_cycles = translator.worst();
+    code_used += code.size();
+    return true;
+}
+
+#endif // CPU6502_JIT
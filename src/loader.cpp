@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+#include "assembler.h"
+#include "cpu_6502.h"
+#include "loader.h"
+#include "mapped_file.h"
+
+namespace {
+
+// Address the Atari binary layout stores its run address at
+const uint16_t RUNAD = 0x02E0;
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+bool covers(const ImageSegment &segment, uint16_t addr) {
+    return addr >= segment.address && addr < segment.address + segment.size;
+}
+
+}
+
+void ProgramImage::load_into(Memory &mem) const {
+    for (const auto &segment : segments) {
+        mem.load(segment.address, segment.data, segment.size);
+    }
+    if (!entry) return;
+    for (const auto &segment : segments) {
+        if (covers(segment, RST_VEC) || covers(segment, RST_VEC + 1)) return;
+    }
+    mem.write_word(RST_VEC, *entry);
+}
+
+size_t ProgramImage::size() const {
+    size_t total = 0;
+    for (const auto &segment : segments) total += segment.size;
+    return total;
+}
+
+ImageFormat Loader::format_for(const std::string &path) {
+    size_t dot = path.find_last_of('.');
+    std::string extension = (dot == std::string::npos) ? "" : path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+
+    if (extension == "prg") return ImageFormat::PRG;
+    if (extension == "hex" || extension == "ihx") return ImageFormat::INTEL_HEX;
+    if (extension == "xex" || extension == "seg") return ImageFormat::SEGMENTED;
+    if (extension == "asm" || extension == "s") return ImageFormat::ASSEMBLY;
+    return ImageFormat::RAW;
+}
+
+ProgramImage Loader::load(const std::string &path, uint16_t raw_address) {
+    return load(path, format_for(path), raw_address);
+}
+
+ProgramImage Loader::load(const std::string &path, ImageFormat format, uint16_t raw_address) {
+    auto file = std::make_shared<const MappedFile>(path);
+    ProgramImage image = parse(file->data(), file->size(), format, raw_address);
+    // Intel HEX and assembled images own their bytes already, the rest point into the mapping
+    if (!image.storage) image.storage = file;
+    return image;
+}
+
+ProgramImage Loader::parse(const uint8_t *data, size_t size, ImageFormat format, uint16_t raw_address) {
+    ProgramImage image;
+    switch (format) {
+        case ImageFormat::RAW:       parse_raw(data, size, raw_address, image); break;
+        case ImageFormat::PRG:       parse_prg(data, size, image); break;
+        case ImageFormat::INTEL_HEX: parse_hex(data, size, image); break;
+        case ImageFormat::SEGMENTED: parse_segmented(data, size, image); break;
+        case ImageFormat::ASSEMBLY:  image = Assembler(raw_address).assemble(std::string_view((const char *) data, size)); break;
+    }
+    return image;
+}
+
+void Loader::add_segment(ProgramImage &image, uint32_t address, const uint8_t *data, size_t size) {
+    if (address + size > 0x10000) {
+        throw std::invalid_argument("Image does not fit in memory");
+    }
+    if (size != 0) image.segments.push_back({ (uint16_t) address, data, size });
+}
+
+void Loader::parse_raw(const uint8_t *data, size_t size, uint16_t address, ProgramImage &image) {
+    add_segment(image, address, data, size);
+    image.entry = address;
+}
+
+void Loader::parse_prg(const uint8_t *data, size_t size, ProgramImage &image) {
+    if (size < 2) throw std::runtime_error("PRG file has no load address");
+    uint16_t address = data[0] | (data[1] << 8);
+    add_segment(image, address, data + 2, size - 2);
+    image.entry = address;
+}
+
+void Loader::parse_hex(const uint8_t *data, size_t size, ProgramImage &image) {
+    auto bytes = std::make_shared<std::vector<uint8_t>>();
+    std::vector<std::pair<uint32_t, size_t>> runs; // Start address and offset into bytes of each contiguous run
+    uint32_t run_end = 0;
+    uint32_t upper = 0; // From extended segment or linear address records
+
+    size_t line = 0;
+    size_t pos = 0;
+    while (pos < size) {
+        size_t end = pos;
+        while (end < size && data[end] != '\n') end++;
+        size_t next = end + 1;
+        line++;
+        while (end > pos && std::isspace(data[end - 1])) end--;
+        while (pos < end && std::isspace(data[pos])) pos++;
+        if (pos == end) {
+            pos = next;
+            continue;
+        }
+
+        auto malformed = [line](const char *what) {
+            return std::runtime_error("Intel HEX line " + std::to_string(line) + ": " + what);
+        };
+        if (data[pos] != ':' || (end - pos) % 2 != 1 || end - pos < 11) throw malformed("not a record");
+
+        // Record bytes: length, address (2), type, data, checksum
+        std::vector<uint8_t> record;
+        uint8_t sum = 0;
+        for (size_t i = pos + 1; i < end; i += 2) {
+            int high = hex_value(data[i]), low = hex_value(data[i + 1]);
+            if (high < 0 || low < 0) throw malformed("bad hex digit");
+            record.push_back(high << 4 | low);
+            sum += record.back();
+        }
+        if (sum != 0) throw malformed("bad checksum");
+        if (record.size() != record[0] + 5u) throw malformed("wrong length");
+
+        const uint8_t *payload = &record[4];
+        uint8_t length = record[0];
+        uint16_t offset = record[1] << 8 | record[2];
+        switch (record[3]) {
+            case 0x00: { // Data
+                uint32_t address = upper + offset;
+                if (address + length > 0x10000) {
+                    throw std::invalid_argument("Image does not fit in memory");
+                }
+                if (runs.empty() || address != run_end) runs.emplace_back(address, bytes->size());
+                bytes->insert(bytes->end(), payload, payload + length);
+                run_end = address + length;
+                break;
+            }
+            case 0x01: // End of file
+                next = size;
+                break;
+            case 0x02: // Extended segment address
+                if (length != 2) throw malformed("bad extended segment address");
+                upper = (payload[0] << 8 | payload[1]) << 4;
+                break;
+            case 0x03: // Start segment address, CS:IP
+                if (length != 4) throw malformed("bad start segment address");
+                image.entry = ((payload[0] << 8 | payload[1]) << 4) + (payload[2] << 8 | payload[3]);
+                break;
+            case 0x04: // Extended linear address
+                if (length != 2) throw malformed("bad extended linear address");
+                upper = (uint32_t) (payload[0] << 8 | payload[1]) << 16;
+                break;
+            case 0x05: // Start linear address
+                if (length != 4) throw malformed("bad start linear address");
+                image.entry = payload[2] << 8 | payload[3];
+                break;
+            default:
+                throw malformed("unknown record type");
+        }
+        pos = next;
+    }
+
+    // Only point into bytes once it has stopped growing
+    for (size_t i = 0; i < runs.size(); i++) {
+        size_t run_size = ((i + 1 < runs.size()) ? runs[i + 1].second : bytes->size()) - runs[i].second;
+        add_segment(image, runs[i].first, bytes->data() + runs[i].second, run_size);
+    }
+    image.storage = bytes;
+}
+
+void Loader::parse_segmented(const uint8_t *data, size_t size, ProgramImage &image) {
+    auto word = [data](size_t at) { return (uint16_t) (data[at] | (data[at + 1] << 8)); };
+    if (size < 2 || word(0) != 0xFFFF) throw std::runtime_error("Segmented image does not start with $FFFF");
+
+    size_t pos = 2;
+    while (pos < size) {
+        if (pos + 2 <= size && word(pos) == 0xFFFF) {
+            pos += 2;
+            continue;
+        }
+        if (pos + 4 > size) throw std::runtime_error("Segmented image has a truncated segment header");
+        uint16_t start = word(pos), end = word(pos + 2);
+        if (end < start) throw std::runtime_error("Segmented image has a segment ending before it starts");
+        size_t length = end - start + 1;
+        pos += 4;
+        if (pos + length > size) throw std::runtime_error("Segmented image has a truncated segment");
+
+        add_segment(image, start, data + pos, length);
+        if (start <= RUNAD && RUNAD + 1 <= end) image.entry = word(pos + RUNAD - start);
+        pos += length;
+    }
+}
@@ -1,97 +1,99 @@
 #include <thread>
 #include <atomic>
-#include <cmath>
 #include <cstdlib>
+#include <sstream>
 #include <SFML/Graphics.hpp>
 
 #include "cpu_6502.h"
-#include "ram.h"
 #include "disassembler.h"
+#include "framebuffer_renderer.h"
+#include "loader.h"
+#include "paged_memory.h"
+#include "scheduler.h"
+#include "spsc_queue.h"
+#include "triple_buffer.h"
 
 int main(int argc, char **argv) {
-    std::ifstream file(argv[1], std::ifstream::binary);
-    if (!file) {
-        std::cerr << "Could not open file " << argv[1] << '\n';
-        std::cout << "Usage: " << argv[0] << " <binary file>\n";
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " <binary file> [clock Hz, 0 for unthrottled]\n";
         return 1;
     }
-    file.seekg (0, file.end);
-    int length = file.tellg();
-    file.seekg (0, file.beg);
-
-    Disassembler d(0x600);
-    d.file_to_strings(file);
-    file = std::ifstream(argv[1], std::ifstream::binary);
+    ProgramImage image;
+    try {
+        image = Loader::load(argv[1]);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << '\n';
+        std::cout << "Usage: " << argv[0] << " <binary file> [clock Hz, 0 for unthrottled]\n";
+        return 1;
+    }
+    double clock_hz = (argc > 2) ? std::atof(argv[2]) : 1600;
 
-    std::shared_ptr<Memory> mem = std::make_shared<RAM<0x10000>>();
-    mem->load_file(file, 0, length-1, 0x600);
-    mem->write_word(RST_VEC, 0x600);
+    TextSink listing(std::cout);
+    for (const auto &segment : image.segments) {
+        Disassembler(segment.address).disassemble(segment.data, segment.size, listing);
+    }
 
-    file.clear();
-    file.seekg(0, file.beg);
+    auto mem = std::make_shared<PagedMemory>();
+    image.load_into(*mem);
+    // A fresh random byte on every read of $FE, rather than one written ahead of every slice
+    // Only that address leaves the zero page's direct pointers
+    mem->map_io(0xfe, [](uint16_t) { return (uint8_t) (std::rand() % 0x100); });
 
     CPU6502 cpu(mem);
 
-    std::unordered_map<int, sf::Color> col {
-         {0x0, sf::Color::Black},
-         {0x1, sf::Color::White},
-         {0x2, sf::Color::Red},
-         {0x3, sf::Color::Cyan},
-         {0x4, sf::Color::Magenta},
-         {0x5, sf::Color::Green},
-         {0x6, sf::Color::Blue},
-         {0x7, sf::Color::Yellow},
-         {0x8, sf::Color(0xFA, 0xA5, 0x00)},
-         {0x9, sf::Color(0xFF, 0xF8, 0xDC)},
-         {0xa, sf::Color(0xFF, 0x4D, 0x4D)},
-         {0xb, sf::Color(0x69, 0x69, 0x69)},
-         {0xc, sf::Color(0xA9, 0xA9, 0xA9)},
-         {0xd, sf::Color(0xAE, 0xF3, 0x59)},
-         {0xe, sf::Color(0x63, 0xC5, 0xDA)},
-         {0xf, sf::Color(0xD3, 0xD3, 0xD3)}
-    };
-
     sf::RenderWindow window(sf::VideoMode(800, 800), "CPU6502");
-    window.setFramerateLimit(0);
+    window.setFramerateLimit(60);
+    FramebufferRenderer renderer;
     sf::Event event;
 
+    // The CPU thread owns mem and cpu outright. It publishes the framebuffer after every slice,
+    // and applies key presses queued by the render thread between slices
+    using Frame = std::array<uint8_t, FramebufferRenderer::size>;
+    TripleBuffer<Frame> frames;
+    SpscQueue<uint8_t, 64> keys;
+
     std::atomic<bool> done { false };
-    std::thread thr([&done, &mem, &cpu] {
-        sf::Clock clock;
+    std::atomic<double> achieved_hz { 0 };
+    std::thread thr([&done, &achieved_hz, &mem, &cpu, &frames, &keys, clock_hz] {
+        Scheduler scheduler(clock_hz);
+        auto run = [&cpu](uint64_t budget) { return cpu.run_cycles(budget).cycles; };
         while(!done){
-            clock.restart();
-            mem->write_byte(0xfe, std::rand()%0x100);
-            cpu.step();
-            // long x = clock.restart().asMicroseconds();
-            const int fps = 1600;
-            // std::cout << x << " " << 1000.0/fps << std::endl;
-            // if (x < 1000.0/fps) std::this_thread::sleep_for(std::chrono::milliseconds((int)(1000.0/fps-x)));
-            std::this_thread::sleep_for(std::chrono::microseconds((int)ceil((1000.0*1000.0)/fps)));
+            uint8_t key;
+            while (keys.pop(key)) mem->write_byte(0xff, key);
+            scheduler.run_slice(run);
+            achieved_hz = scheduler.achieved_hz();
+
+            Frame &frame = frames.back();
+            for (size_t i = 0; i < frame.size(); i++) {
+                frame[i] = mem->read_byte(FramebufferRenderer::base + i);
+            }
+            frames.publish();
         }
     });
+    sf::Clock title_clock;
     while (window.isOpen()) {
         while (window.pollEvent(event)) {
             if (event.type == sf::Event::Closed)
                 window.close();
             if (event.type == sf::Event::KeyPressed) {
-                if (event.key.code == sf::Keyboard::W) mem->write_byte(0xff, 0x77);
-                if (event.key.code == sf::Keyboard::A) mem->write_byte(0xff, 0x61);
-                if (event.key.code == sf::Keyboard::S) mem->write_byte(0xff, 0x73);
-                if (event.key.code == sf::Keyboard::D) mem->write_byte(0xff, 0x64);
+                if (event.key.code == sf::Keyboard::W) keys.push(0x77);
+                if (event.key.code == sf::Keyboard::A) keys.push(0x61);
+                if (event.key.code == sf::Keyboard::S) keys.push(0x73);
+                if (event.key.code == sf::Keyboard::D) keys.push(0x64);
             }
         }
-        window.clear(sf::Color::Black);
-        for (int i = 0x200; i < 0x600; i += 0x20) {
-            for (int j = i; j < i+0x20; j++) {
-                sf::RectangleShape pixel(sf::Vector2f(10, 10));
-                // pixel.setPosition(((i-0x200)/0x20)*5, 5*(j-0x200));
-                pixel.setPosition(10*(j%0x20), 10*((i-0x200)/0x20));
-                pixel.setFillColor(col[mem->read_byte(j)&0xF]);
-                window.draw(pixel);
-            }
-            // std::cout << std::endl;
+        if (title_clock.getElapsedTime().asSeconds() >= 1) {
+            title_clock.restart();
+            std::stringstream title;
+            title << "CPU6502 - " << std::fixed << std::setprecision(4) << achieved_hz / 1e6 << " MHz";
+            if (clock_hz > 0) title << " of " << clock_hz / 1e6 << " MHz";
+            window.setTitle(title.str());
         }
 
+        if (frames.update()) renderer.update(frames.front().data());
+
+        window.clear(sf::Color::Black);
+        renderer.draw(window);
         window.display();
     }
     done = true;
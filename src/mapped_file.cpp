@@ -0,0 +1,36 @@
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+
+MappedFile::MappedFile(const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Could not open file " + path);
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("Could not stat file " + path);
+    }
+    length = info.st_size;
+
+    // mmap rejects empty mappings, so an empty file is left as nullptr
+    if (length != 0) {
+        void *mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Could not map file " + path);
+        }
+        madvise(mapping, length, MADV_SEQUENTIAL);
+        bytes = static_cast<const uint8_t*>(mapping);
+    }
+    // The mapping outlives the descriptor
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (bytes) munmap(const_cast<uint8_t*>(bytes), length);
+}
@@ -0,0 +1,171 @@
+#include <algorithm>
+
+#include "paged_memory.h"
+
+PagedMemory::PagedMemory() {
+    // Every page starts out sharing the same zeroed page
+    auto image = std::make_shared<Image>();
+    image->pages.fill(std::make_shared<const Page>(Page{}));
+    image->types.fill(PageType::RAM);
+    base = image;
+    types = image->types;
+    for (int page = 0; page < 0x100; page++) update_page(page);
+}
+
+PagedMemory::PagedMemory(const Snapshot &snapshot) {
+    restore(snapshot);
+}
+
+void PagedMemory::load_file(std::ifstream &file, std::istream::pos_type in_start, std::istream::pos_type in_end, uint16_t mem_start) {
+    std::streamoff length = std::min<std::streamoff>(in_end - in_start + 1, 0x10000 - mem_start);
+    if (length <= 0) return;
+
+    file.seekg(in_start, file.beg);
+    uint32_t addr = mem_start;
+    uint32_t end = mem_start + length;
+    while (addr < end) {
+        uint32_t chunk = std::min<uint32_t>(end - addr, 0x100 - (addr & 0xFF));
+        file.read(reinterpret_cast<char*>(&own_page(addr >> 8)[addr & 0xFF]), chunk);
+        addr += chunk;
+    }
+}
+
+void PagedMemory::load(uint16_t addr, const uint8_t *data, size_t length) {
+    uint32_t end = std::min<uint32_t>(addr + length, 0x10000);
+    for (uint32_t at = addr; at < end;) {
+        uint32_t chunk = std::min<uint32_t>(end - at, 0x100 - (at & 0xFF));
+        std::copy_n(data + (at - addr), chunk, &own_page(at >> 8)[at & 0xFF]);
+        at += chunk;
+    }
+}
+
+void PagedMemory::print() {
+    for (int page = 0; page < 0x100; page++) {
+        const Page &data = dirty[page] ? *dirty[page] : *base->pages[page];
+        for (auto& b : data) {
+            std::cout << std::hex << std::setfill('0') << std::setw(2) << (int) b;
+        }
+    }
+    std::cout << "\n";
+}
+
+void PagedMemory::map_ram(uint8_t first_page, int count) {
+    for (int page = first_page; page < first_page + count && page < 0x100; page++) {
+        set_page(page, PageType::RAM);
+    }
+}
+
+void PagedMemory::map_rom(uint8_t first_page, int count) {
+    for (int page = first_page; page < first_page + count && page < 0x100; page++) {
+        set_page(page, PageType::ROM);
+    }
+}
+
+void PagedMemory::map_io(uint16_t addr, read_handler_t read, write_handler_t write) {
+    uint8_t page = addr >> 8;
+
+    // The ports may be shared with a snapshot, so they are replaced rather than modified
+    auto ports = io_pages[page] ? std::make_shared<IOPage>(*io_pages[page]) : std::make_shared<IOPage>();
+    ports->ports[addr & 0xFF] = { read, write };
+    ports->mapped[addr & 0xFF] = read || write;
+    io_pages[page] = ports;
+    set_page(page, PageType::IO);
+}
+
+PagedMemory::Snapshot PagedMemory::snapshot() {
+    auto image = std::make_shared<Image>();
+    for (int page = 0; page < 0x100; page++) {
+        if (dirty[page]) image->pages[page] = std::move(dirty[page]);
+        else image->pages[page] = base->pages[page];
+    }
+    image->types = types;
+    image->io_pages = io_pages;
+
+    base = image;
+    written.clear();
+    remapped = false;
+    for (int page = 0; page < 0x100; page++) update_page(page);
+    return Snapshot(image);
+}
+
+void PagedMemory::restore(const Snapshot &snapshot) {
+    if (snapshot.image == base && !remapped) {
+        // Rewinding to the current base only has to drop the pages written since
+        for (uint8_t page : written) {
+            dirty[page].reset();
+            update_page(page);
+        }
+        written.clear();
+        return;
+    }
+
+    base = snapshot.image;
+    types = base->types;
+    io_pages = base->io_pages;
+    for (int page = 0; page < 0x100; page++) {
+        dirty[page].reset();
+        update_page(page);
+    }
+    written.clear();
+    remapped = false;
+}
+
+void PagedMemory::set_page(uint8_t page, PageType type) {
+    types[page] = type;
+    remapped = true;
+    if (type != PageType::IO) io_pages[page].reset();
+    update_page(page);
+}
+
+// Writes only take the fast path once the page has a private copy
+void PagedMemory::update_page(uint8_t page) {
+    uint8_t *data = dirty[page] ? dirty[page]->data() : nullptr;
+    // Pages of the base image are never written through these pointers
+    uint8_t *shared = const_cast<uint8_t*>(base->pages[page]->data());
+    pages.read[page] = (types[page] != PageType::IO) ? (data ? data : shared) : nullptr;
+    pages.write[page] = (types[page] == PageType::RAM) ? data : nullptr;
+
+    // I/O pages are left out of the fast path above, but the addresses without handlers
+    // are still accessed directly, after checking the mapped flags
+    if (types[page] == PageType::IO) {
+        if (!mixed[page]) mixed[page] = std::make_unique<MixedPage>();
+        mixed[page]->read = data ? data : shared;
+        mixed[page]->write = data;
+        mixed[page]->io = io_pages[page]->mapped;
+    }
+    else {
+        mixed[page].reset();
+    }
+    pages.io[page] = mixed[page].get();
+}
+
+PagedMemory::Page &PagedMemory::own_page(uint8_t page) {
+    if (!dirty[page]) {
+        dirty[page] = std::make_unique<Page>(*base->pages[page]);
+        written.push_back(page);
+        update_page(page);
+    }
+    return *dirty[page];
+}
+
+// Only reached for I/O pages, since every other page has a read pointer
+uint8_t PagedMemory::read_slow(uint16_t addr) {
+    uint8_t page = addr >> 8;
+    const IOPort &port = io_pages[page]->ports[addr & 0xFF];
+    if (port.read) return port.read(addr);
+    return mixed[page]->read[addr & 0xFF];
+}
+
+void PagedMemory::write_slow(uint16_t addr, uint8_t data) {
+    uint8_t page = addr >> 8;
+    if (types[page] == PageType::ROM) return;
+
+    if (types[page] == PageType::IO) {
+        const IOPort &port = io_pages[page]->ports[addr & 0xFF];
+        if (port.write) {
+            port.write(addr, data);
+            return;
+        }
+    }
+    own_page(page)[addr & 0xFF] = data;
+}
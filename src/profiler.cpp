@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+#include "disassembler.h"
+#include "profiler.h"
+
+namespace {
+
+// Share of total as a percentage, for the report columns
+double percent(uint64_t part, uint64_t total) {
+    return total ? 100.0 * part / total : 0.0;
+}
+
+// Caller and callee totals, keyed by (caller, callee) entry address
+typedef struct Edge {
+    uint64_t calls = 0;
+    uint64_t cycles = 0; // Inclusive cycles of the callee when called from the caller
+} Edge;
+
+typedef struct Function {
+    uint64_t calls = 0;
+    uint64_t self_cycles = 0;
+    uint64_t inclusive_cycles = 0;
+} Function;
+
+// Stands for the root node in call graph edges, which have an entry address otherwise
+const uint32_t ROOT = 0x10000;
+
+}
+
+Profiler::Profiler() : pcs(std::make_unique<std::array<PCProfile, 0x10000>>()) {
+    clear();
+}
+
+void Profiler::clear() {
+    pcs->fill({});
+    opcodes.fill({});
+    nodes.assign(1, CallNode{ 0, 0, 0, 0 });
+    children.clear();
+    stack.clear();
+    current = 0;
+}
+
+void Profiler::call(uint16_t address, uint8_t stack_pointer) {
+    // Calls whose return addresses lie at or above this one's were abandoned, e.g. by resetting S
+    while (!stack.empty() && stack.back().stack_pointer <= stack_pointer) stack.pop_back();
+    uint32_t parent = stack.empty() ? 0 : stack.back().node;
+
+    uint64_t key = (uint64_t) parent << 16 | address;
+    auto it = children.find(key);
+    if (it == children.end()) {
+        it = children.emplace(key, (uint32_t) nodes.size()).first;
+        nodes.push_back({ address, parent, 0, 0 });
+    }
+    nodes[it->second].calls++;
+    stack.push_back({ it->second, stack_pointer });
+    current = it->second;
+}
+
+void Profiler::ret(uint8_t stack_pointer) {
+    // A matching return leaves S where it was before the call
+    // Returns through an address pushed by hand leave S below it, and pop nothing
+    while (!stack.empty() && stack.back().stack_pointer <= stack_pointer) stack.pop_back();
+    current = stack.empty() ? 0 : stack.back().node;
+}
+
+std::string Profiler::node_name(uint16_t address) {
+    std::stringstream ss;
+    ss << "sub_" << std::uppercase << std::hex << std::setfill('0') << std::setw(4) << address;
+    return ss.str();
+}
+
+void Profiler::print(std::ostream &out, size_t limit) const {
+    auto cap = [limit](size_t size) { return limit ? std::min(limit, size) : size; };
+
+    uint64_t instructions = 0, cycles = 0;
+    for (const auto &counters : opcodes) {
+        instructions += counters.count;
+        cycles += counters.cycles;
+    }
+    std::ios::fmtflags flags = out.flags();
+    out << "Executed " << instructions << " instructions in " << cycles << " cycles\n\n";
+
+    std::vector<uint32_t> hot;
+    for (uint32_t pc = 0; pc < 0x10000; pc++) {
+        if ((*pcs)[pc].counters.count) hot.push_back(pc);
+    }
+    std::sort(hot.begin(), hot.end(), [this](uint32_t a, uint32_t b) {
+        return (*pcs)[a].counters.cycles > (*pcs)[b].counters.cycles;
+    });
+
+    out << "Address  Instruction       " << std::setw(12) << "Count" << std::setw(14) << "Cycles"
+        << std::setw(8) << "%" << std::setw(12) << "Extra" << '\n';
+    for (size_t i = 0; i < cap(hot.size()); i++) {
+        const PCProfile &at = (*pcs)[hot[i]];
+        std::string text = Disassembler::is_instruction(at.opcode)
+            ? Disassembler::to_string({ (uint16_t) hot[i], at.operand, at.opcode,
+                                        (uint8_t) (Instructions::length_table[at.opcode] + 1) })
+            : "???";
+        out << std::uppercase << std::hex << std::setfill('0') << std::setw(4) << hot[i]
+            << std::dec << std::setfill(' ') << "     " << std::left << std::setw(18) << text << std::right
+            << std::setw(12) << at.counters.count << std::setw(14) << at.counters.cycles
+            << std::fixed << std::setprecision(2) << std::setw(8) << percent(at.counters.cycles, cycles)
+            << std::setw(12) << at.counters.extra_cycles << '\n';
+    }
+
+    std::vector<int> used;
+    for (int opcode = 0; opcode < 0x100; opcode++) {
+        if (opcodes[opcode].count) used.push_back(opcode);
+    }
+    std::sort(used.begin(), used.end(), [this](int a, int b) { return opcodes[a].cycles > opcodes[b].cycles; });
+
+    out << "\nOpcode  Mnemonic  Mode " << std::setw(12) << "Count" << std::setw(14) << "Cycles"
+        << std::setw(8) << "%" << std::setw(12) << "Extra" << '\n';
+    for (size_t i = 0; i < cap(used.size()); i++) {
+        const ProfileCounters &of = opcodes[used[i]];
+        const InstrInfo &info = Instructions::info[used[i]];
+        out << "  " << std::uppercase << std::hex << std::setfill('0') << std::setw(2) << used[i]
+            << std::dec << std::setfill(' ') << "    " << std::left
+            << std::setw(10) << Instructions::op_name(info.op)
+            << std::setw(5) << (info.op != Op::ILLEGAL ? Instructions::mode_name(info.mode) : "") << std::right
+            << std::setw(12) << of.count << std::setw(14) << of.cycles
+            << std::fixed << std::setprecision(2) << std::setw(8) << percent(of.cycles, cycles)
+            << std::setw(12) << of.extra_cycles << '\n';
+    }
+
+    // Subtree totals, children always come after their parent
+    std::vector<uint64_t> inclusive(nodes.size());
+    for (size_t i = nodes.size(); i-- > 1; ) {
+        inclusive[i] += nodes[i].self_cycles;
+        inclusive[nodes[i].parent] += inclusive[i];
+    }
+
+    // Recursive calls are only counted once towards inclusive cycles, at the outermost one
+    std::map<uint16_t, Function> functions;
+    std::map<std::pair<uint32_t, uint32_t>, Edge> edges;
+    for (size_t i = 1; i < nodes.size(); i++) {
+        const CallNode &node = nodes[i];
+        Function &function = functions[node.address];
+        function.calls += node.calls;
+        function.self_cycles += node.self_cycles;
+
+        bool outermost = true;
+        for (uint32_t up = node.parent; up != 0 && outermost; up = nodes[up].parent) {
+            outermost = nodes[up].address != node.address;
+        }
+        if (outermost) function.inclusive_cycles += inclusive[i];
+
+        Edge &edge = edges[{ node.parent ? nodes[node.parent].address : ROOT, node.address }];
+        edge.calls += node.calls;
+        edge.cycles += inclusive[i];
+    }
+
+    std::vector<std::pair<uint16_t, Function>> ranked(functions.begin(), functions.end());
+    std::sort(ranked.begin(), ranked.end(), [](const auto &a, const auto &b) {
+        return a.second.inclusive_cycles > b.second.inclusive_cycles;
+    });
+
+    out << "\nSubroutine  " << std::setw(12) << "Calls" << std::setw(14) << "Self"
+        << std::setw(14) << "Inclusive" << std::setw(8) << "%" << '\n';
+    out << std::left << std::setw(12) << "root" << std::right << std::setw(12) << ""
+        << std::setw(14) << nodes[0].self_cycles << std::setw(14) << cycles
+        << std::fixed << std::setprecision(2) << std::setw(8) << percent(cycles, cycles) << '\n';
+    for (size_t i = 0; i < cap(ranked.size()); i++) {
+        uint16_t address = ranked[i].first;
+        const Function &function = ranked[i].second;
+        out << std::left << std::setw(12) << node_name(address) << std::right
+            << std::setw(12) << function.calls << std::setw(14) << function.self_cycles
+            << std::setw(14) << function.inclusive_cycles
+            << std::fixed << std::setprecision(2) << std::setw(8) << percent(function.inclusive_cycles, cycles) << '\n';
+        for (const auto &edge : edges) {
+            if (edge.first.second == address) {
+                std::string caller = (edge.first.first == ROOT) ? "root" : node_name(edge.first.first);
+                out << "    from " << std::left << std::setw(8) << caller << std::right << std::setw(12) << edge.second.calls << " calls\n";
+            }
+        }
+        for (const auto &edge : edges) {
+            if (edge.first.first == address) {
+                out << "    to   " << std::left << std::setw(8) << node_name(edge.first.second) << std::right << std::setw(12) << edge.second.calls << " calls"
+                    << std::setw(14) << edge.second.cycles << " cycles\n";
+            }
+        }
+    }
+    out.flags(flags);
+}
+
+void Profiler::print_folded(std::ostream &out) const {
+    std::vector<std::string> paths(nodes.size());
+    paths[0] = "root";
+    for (size_t i = 1; i < nodes.size(); i++) {
+        paths[i] = paths[nodes[i].parent] + ";" + node_name(nodes[i].address);
+    }
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (nodes[i].self_cycles) out << paths[i] << ' ' << nodes[i].self_cycles << '\n';
+    }
+}
@@ -0,0 +1,57 @@
+#include <algorithm>
+#include <thread>
+
+#include "scheduler.h"
+
+Scheduler::Scheduler(double clock_hz, clock::duration quantum)
+        : clock_hz{clock_hz}, quantum{quantum} {
+    resync(clock::now());
+    reset_stats();
+}
+
+uint64_t Scheduler::run_slice(const run_t &run) {
+    if (!is_throttled()) {
+        uint64_t used = run(unthrottled_slice);
+        stats_cycles += used;
+        return used;
+    }
+
+    slices++;
+    clock::time_point deadline = start + slices * quantum;
+
+    // Cycles due by the deadline are computed from the start, so rounding never accumulates
+    double elapsed = std::chrono::duration<double>(slices * quantum).count();
+    uint64_t due = (uint64_t) (elapsed * clock_hz);
+    uint64_t budget = (due > cycles_run) ? due - cycles_run : 0;
+
+    uint64_t used = run(budget);
+    stats_cycles += used;
+    // A machine that stopped early is not owed its missing cycles in later slices
+    cycles_run = std::max(cycles_run + used, due);
+
+    clock::time_point now = clock::now();
+    if (now < deadline) {
+        std::this_thread::sleep_until(deadline);
+    }
+    else if (now - deadline > max_lag * quantum) {
+        // Too far behind (e.g. the host was suspended), so drop the backlog
+        resync(now);
+    }
+    return used;
+}
+
+double Scheduler::achieved_hz() const {
+    double elapsed = std::chrono::duration<double>(clock::now() - stats_start).count();
+    return (elapsed > 0) ? stats_cycles / elapsed : 0;
+}
+
+void Scheduler::reset_stats() {
+    stats_start = clock::now();
+    stats_cycles = 0;
+}
+
+void Scheduler::resync(clock::time_point now) {
+    start = now;
+    slices = 0;
+    cycles_run = 0;
+}
@@ -0,0 +1,95 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(size_t threads)
+        : queued{0}, unfinished{0}, next_worker{0}, stopping{false} {
+    if (threads == 0) threads = 1;
+    for (size_t i = 0; i < threads; i++) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < threads; i++) {
+        this->threads.emplace_back(&ThreadPool::work, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(state_lock);
+        stopping = true;
+    }
+    work_available.notify_all();
+    for (auto &thread : threads) thread.join();
+}
+
+void ThreadPool::submit(task_t task) {
+    size_t index;
+    {
+        std::lock_guard<std::mutex> guard(state_lock);
+        index = next_worker++ % workers.size();
+        unfinished++;
+    }
+    {
+        std::lock_guard<std::mutex> guard(workers[index]->lock);
+        workers[index]->tasks.push_back(std::move(task));
+    }
+    {
+        // Published under state_lock so a worker about to sleep cannot miss it
+        std::lock_guard<std::mutex> guard(state_lock);
+        queued++;
+    }
+    work_available.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> guard(state_lock);
+    all_done.wait(guard, [this] { return unfinished == 0; });
+    if (error) {
+        std::exception_ptr e = error;
+        error = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+// Takes from the back of this worker's own queue, or else steals from the front of another's
+bool ThreadPool::take(size_t index, task_t &task) {
+    for (size_t i = 0; i < workers.size(); i++) {
+        Worker &worker = *workers[(index + i) % workers.size()];
+        std::lock_guard<std::mutex> guard(worker.lock);
+        if (worker.tasks.empty()) continue;
+
+        if (i == 0) {
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+        }
+        else {
+            task = std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+        }
+        queued--;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::work(size_t index) {
+    task_t task;
+    while (true) {
+        if (!take(index, task)) {
+            std::unique_lock<std::mutex> guard(state_lock);
+            work_available.wait(guard, [this] { return stopping || queued > 0; });
+            if (stopping && queued <= 0) return;
+            continue;
+        }
+
+        try {
+            task(index);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> guard(state_lock);
+            if (!error) error = std::current_exception();
+        }
+        task = nullptr;
+
+        std::lock_guard<std::mutex> guard(state_lock);
+        if (--unfinished == 0) all_done.notify_all();
+    }
+}
@@ -0,0 +1,37 @@
+#include <iomanip>
+#include <sstream>
+
+#include "trace.h"
+#include "disassembler.h"
+
+TraceBuffer::TraceBuffer(size_t capacity) : head(0) {
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    records.resize(size);
+    mask = size - 1;
+}
+
+std::string TraceBuffer::record_to_string(const TraceRecord &record) {
+    std::stringstream ss;
+    ss << std::uppercase << std::hex << std::setfill('0')
+       << std::setw(4) << (int) record.PC << "  " << std::setw(2) << (int) record.opcode << "  ";
+
+    std::string text = Disassembler::is_instruction(record.opcode)
+        ? Disassembler::to_string({ record.PC, record.operand, record.opcode,
+                                    (uint8_t) (Instructions::length_table[record.opcode] + 1) })
+        : "???";
+    ss << std::left << std::setfill(' ') << std::setw(12) << text << std::right << std::setfill('0')
+       << " A:" << std::setw(2) << (int) record.A
+       << " X:" << std::setw(2) << (int) record.X
+       << " Y:" << std::setw(2) << (int) record.Y
+       << " P:" << std::setw(2) << (int) record.P
+       << " S:" << std::setw(2) << (int) record.S
+       << " CYC:" << std::dec << record.cycle;
+    return ss.str();
+}
+
+void TraceBuffer::print(std::ostream &out) const {
+    for (size_t i = 0; i < size(); i++) {
+        out << record_to_string((*this)[i]) << '\n';
+    }
+}
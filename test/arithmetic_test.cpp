@@ -0,0 +1,109 @@
+#include <array>
+#include <cstdint>
+#include <iostream>
+
+#include "arithmetic.h"
+#include "test.h"
+
+// Recomputes every entry of the ADC and SBC tables from the reference algorithms in Bruce Clark's
+// "Decimal Mode" tutorial (6502.org), written out step by step rather than shared with the library
+
+namespace {
+
+const unsigned N = 0x80, V = 0x40, Z = 0x02, C = 0x01;
+
+unsigned reference_flags(unsigned result, bool overflow, bool carry) {
+    return ((result & 0x80) ? N : 0) | (overflow ? V : 0) | ((result & 0xFF) == 0 ? Z : 0) | (carry ? C : 0);
+}
+
+// Binary mode, from the signed and unsigned values of the operands
+uint16_t reference_adc_binary(unsigned a, unsigned b, unsigned c) {
+    unsigned sum = a + b + c;
+    int signed_sum = (int8_t) a + (int8_t) b + (int) c;
+    return reference_flags(sum, signed_sum < -128 || signed_sum > 127, sum > 0xFF) << 8 | (sum & 0xFF);
+}
+
+uint16_t reference_sbc_binary(unsigned a, unsigned b, unsigned c) {
+    int difference = (int) a - (int) b - (int) (1 - c);
+    int signed_difference = (int8_t) a - (int8_t) b - (int) (1 - c);
+    return reference_flags(difference & 0xFF, signed_difference < -128 || signed_difference > 127,
+                           difference >= 0) << 8 | (difference & 0xFF);
+}
+
+// Sequence 1 for the accumulator and carry, sequence 2 for N and V, and Z from the binary sum
+uint16_t reference_adc_decimal(unsigned a, unsigned b, unsigned c) {
+    int al = (a & 0x0F) + (b & 0x0F) + c;                     // 1a
+    if (al >= 0x0A) al = ((al + 0x06) & 0x0F) + 0x10;          // 1b
+    int result = (a & 0xF0) + (b & 0xF0) + al;                 // 1c
+    int signed_result = (int8_t) (a & 0xF0) + (int8_t) (b & 0xF0) + al; // 2c
+    if (result >= 0xA0) result += 0x60;                        // 1e
+
+    unsigned flags = ((signed_result & 0x80) ? N : 0)          // 2e
+                   | (signed_result < -128 || signed_result > 127 ? V : 0) // 2f
+                   | (((a + b + c) & 0xFF) == 0 ? Z : 0)
+                   | (result >= 0x100 ? C : 0);                // 1g
+    return flags << 8 | (result & 0xFF);                       // 1f
+}
+
+// Sequence 3 for the accumulator, with every flag as in binary mode
+uint16_t reference_sbc_decimal(unsigned a, unsigned b, unsigned c) {
+    int al = (int) (a & 0x0F) - (int) (b & 0x0F) + (int) c - 1; // 3a
+    if (al < 0) al = ((al - 0x06) & 0x0F) - 0x10;              // 3b
+    int result = (int) (a & 0xF0) - (int) (b & 0xF0) + al;     // 3c
+    if (result < 0) result -= 0x60;                            // 3d
+    return (reference_sbc_binary(a, b, c) & 0xFF00) | (result & 0xFF); // 3e
+}
+
+void test_tables() {
+    int mismatches = 0;
+    for (unsigned p : { 0x00u, C, 0x08u, 0x08u | C }) {
+        bool decimal = p & 0x08;
+        unsigned c = p & C;
+        for (unsigned a = 0; a < 0x100; a++) {
+            for (unsigned b = 0; b < 0x100; b++) {
+                size_t i = Arithmetic::index(a, b, p);
+                uint16_t adc = decimal ? reference_adc_decimal(a, b, c) : reference_adc_binary(a, b, c);
+                uint16_t sbc = decimal ? reference_sbc_decimal(a, b, c) : reference_sbc_binary(a, b, c);
+                if (Arithmetic::adc_table[i] == adc && Arithmetic::sbc_table[i] == sbc) continue;
+
+                std::cerr << std::hex << "A=$" << a << " operand=$" << b << " P=$" << p << std::dec << '\n';
+                CHECK_EQ(Arithmetic::adc_table[i], adc);
+                CHECK_EQ(Arithmetic::sbc_table[i], sbc);
+                if (++mismatches == 8) return;
+            }
+        }
+    }
+}
+
+// Worked by hand from the tutorial's sequences, in and outside BCD
+void test_known_results() {
+    auto adc = [](unsigned a, unsigned b, unsigned p) { return Arithmetic::adc_table[Arithmetic::index(a, b, p)]; };
+    auto sbc = [](unsigned a, unsigned b, unsigned p) { return Arithmetic::sbc_table[Arithmetic::index(a, b, p)]; };
+    const unsigned D = 0x08;
+
+    // N and V from the intermediate $A5
+    CHECK_EQ(adc(0x58, 0x46, D | C), ((N | V | C) << 8) | 0x05);
+    CHECK_EQ(adc(0x12, 0x34, D), 0x46);
+    CHECK_EQ(adc(0x15, 0x26, D), 0x41);
+    CHECK_EQ(adc(0x81, 0x92, D), ((V | C) << 8) | 0x73);
+    // Z from the binary sum $9A, N from the intermediate $A0
+    CHECK_EQ(adc(0x99, 0x01, D), ((N | C) << 8) | 0x00);
+    // Invalid BCD
+    CHECK_EQ(adc(0x0F, 0x0F, D), 0x14);
+    CHECK_EQ(adc(0xFF, 0xFF, D | C), ((N | C) << 8) | 0x55);
+
+    CHECK_EQ(sbc(0x46, 0x12, D | C), (C << 8) | 0x34);
+    CHECK_EQ(sbc(0x40, 0x13, D | C), (C << 8) | 0x27);
+    CHECK_EQ(sbc(0x32, 0x02, D), (C << 8) | 0x29);
+    CHECK_EQ(sbc(0x12, 0x21, D | C), (N << 8) | 0x91);
+    CHECK_EQ(sbc(0x21, 0x34, D | C), (N << 8) | 0x87);
+    CHECK_EQ(sbc(0x00, 0x01, D | C), (N << 8) | 0x99);
+}
+
+}
+
+int main() {
+    test_tables();
+    test_known_results();
+    return test_result();
+}
@@ -0,0 +1,51 @@
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include "assembler.h"
+#include "test.h"
+
+// Expression arithmetic, which wraps at 32 bits like the host's unsigned integers
+
+namespace {
+
+// The word a single .word statement assembles to
+uint16_t word(const std::string &expression) {
+    uint8_t buffer[2] = {};
+    Assembler().assemble(".word " + expression, buffer, sizeof(buffer), 0x600);
+    return buffer[0] | (buffer[1] << 8);
+}
+
+bool fails(const std::string &source) {
+    uint8_t buffer[16];
+    try {
+        Assembler().assemble(source, buffer, sizeof(buffer), 0x600);
+    } catch (const std::runtime_error &) {
+        return true;
+    }
+    return false;
+}
+
+void test_division() {
+    CHECK_EQ(word("7/2"), 3);
+    CHECK_EQ(word("-7/2+10"), 7);
+    CHECK_EQ(word("$FFFF/-1*-1"), 0xFFFF);
+    CHECK(fails(".word 1/0"));
+
+    // $8000*$8000*2 wraps to INT32_MIN, whose quotient by -1 wraps back to itself
+    CHECK_EQ(word("$8000*$8000*2/-1/$100/$100*-1"), 0x8000);
+    CHECK(fails(".word $8000*$8000*2/-1"));
+}
+
+void test_wrapping() {
+    CHECK_EQ(word("$8000*$8000*4+$1234"), 0x1234);
+    CHECK_EQ(word("$8000*$8000*2*-1/$100/$100*-1"), 0x8000);
+}
+
+}
+
+int main() {
+    test_division();
+    test_wrapping();
+    return test_result();
+}
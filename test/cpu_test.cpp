@@ -0,0 +1,402 @@
+#include <memory>
+#include <string_view>
+
+#include "assembler.h"
+#include "cpu_6502.h"
+#include "event_scheduler.h"
+#include "paged_memory.h"
+#include "ram.h"
+#include "test.h"
+
+// Instruction behaviour the NMOS 6502 documents, and the CPU once got wrong
+// Every check runs on each bus the library ships, since they take different paths to memory
+
+namespace {
+
+std::shared_ptr<RAM<0x10000>> make_bus(RAM<0x10000>*) {
+    auto mem = std::make_shared<RAM<0x10000>>();
+    mem->clear();
+    return mem;
+}
+
+std::shared_ptr<Memory> make_bus(Memory*) {
+    return make_bus((RAM<0x10000>*) nullptr);
+}
+
+std::shared_ptr<PagedMemory> make_bus(PagedMemory*) {
+    return std::make_shared<PagedMemory>();
+}
+
+// A CPU reset into source, which is assembled at $0600 with the IRQ/BRK vector at $0700
+// and the NMI vector at $0800
+template <class Bus>
+struct Machine {
+    std::shared_ptr<Bus> mem;
+    std::unique_ptr<CPU6502<Bus>> cpu;
+
+    Machine(std::string_view source) : mem{make_bus((Bus*) nullptr)} {
+        uint16_t entry = Assembler().assemble(source, *mem);
+        mem->write_word(RST_VEC, entry);
+        if (mem->read_word(IRQ_VEC) == 0) mem->write_word(IRQ_VEC, 0x0700);
+        if (mem->read_word(NMI_VEC) == 0) mem->write_word(NMI_VEC, 0x0800);
+        cpu = std::make_unique<CPU6502<Bus>>(mem);
+    }
+
+    Registers step(uint64_t count=1) {
+        cpu->run_instructions(count);
+        return cpu->get_registers();
+    }
+};
+
+template <class Bus>
+void test_compare() {
+    Machine<Bus> m("LDA #$40\n CMP #$40\n CMP #$41\n CMP #$3F\n"
+                   "LDX #$00\n CPX #$01\n LDY #$FF\n CPY #$FF");
+    m.step();
+    CHECK_EQ(m.step().P, CONSTANT | ZERO | CARRY);
+    CHECK_EQ(m.step().P, CONSTANT | NEGATIVE);
+    CHECK_EQ(m.step().P, CONSTANT | CARRY);
+    m.step();
+    CHECK_EQ(m.step().P, CONSTANT | NEGATIVE);
+    m.step();
+    CHECK_EQ(m.step().P, CONSTANT | ZERO | CARRY);
+}
+
+template <class Bus>
+void test_bit() {
+    // N and V come from memory, Z from memory AND A, and A is left alone
+    Machine<Bus> m("LDA #$01\n BIT $10\n BIT $11\n BIT $12\n"
+                   ".org $10\n .byte $C0, $01, $40");
+    m.step();
+    Registers r = m.step();
+    CHECK_EQ(r.P, CONSTANT | NEGATIVE | OVERFLOW | ZERO);
+    CHECK_EQ(r.A, 0x01);
+    CHECK_EQ(m.step().P, CONSTANT);
+    CHECK_EQ(m.step().P, CONSTANT | OVERFLOW | ZERO);
+}
+
+template <class Bus>
+void test_binary_overflow() {
+    Machine<Bus> m("CLC\n LDA #$50\n ADC #$50\n"
+                   "CLC\n LDA #$D0\n ADC #$90\n"
+                   "CLC\n LDA #$50\n ADC #$10\n"
+                   "SEC\n LDA #$50\n SBC #$B0\n"
+                   "SEC\n LDA #$D0\n SBC #$70\n"
+                   "SEC\n LDA #$50\n SBC #$30");
+    Registers r = m.step(3);
+    CHECK_EQ(r.A, 0xA0);
+    CHECK_EQ(r.P, CONSTANT | NEGATIVE | OVERFLOW);
+    r = m.step(3);
+    CHECK_EQ(r.A, 0x60);
+    CHECK_EQ(r.P, CONSTANT | OVERFLOW | CARRY);
+    r = m.step(3);
+    CHECK_EQ(r.A, 0x60);
+    CHECK_EQ(r.P, CONSTANT);
+    r = m.step(3);
+    CHECK_EQ(r.A, 0xA0);
+    CHECK_EQ(r.P, CONSTANT | NEGATIVE | OVERFLOW);
+    r = m.step(3);
+    CHECK_EQ(r.A, 0x60);
+    CHECK_EQ(r.P, CONSTANT | OVERFLOW | CARRY);
+    r = m.step(3);
+    CHECK_EQ(r.A, 0x20);
+    CHECK_EQ(r.P, CONSTANT | CARRY);
+}
+
+template <class Bus>
+void test_pla_txs_flags() {
+    // PLA sets N and Z from the value pulled, TXS leaves the flags alone
+    Machine<Bus> m("LDA #$80\n PHA\n LDA #$01\n PLA\n"
+                   "LDA #$00\n PHA\n LDA #$01\n PLA\n"
+                   "LDX #$00\n LDA #$01\n TXS\n"
+                   "LDX #$80\n LDA #$00\n TXS");
+    Registers r = m.step(4);
+    CHECK_EQ(r.A, 0x80);
+    CHECK_EQ(r.P, CONSTANT | NEGATIVE);
+    r = m.step(4);
+    CHECK_EQ(r.A, 0x00);
+    CHECK_EQ(r.P, CONSTANT | ZERO);
+    r = m.step(3);
+    CHECK_EQ(r.S, 0x00);
+    CHECK_EQ(r.P, CONSTANT);
+    r = m.step(3);
+    CHECK_EQ(r.S, 0x80);
+    CHECK_EQ(r.P, CONSTANT | ZERO);
+}
+
+template <class Bus>
+void test_y_indexed_ldx_stx() {
+    // Written out as bytes, so the test does not depend on the assembler choosing these opcodes
+    Machine<Bus> m("LDY #$05\n .byte $B6, $10\n"      // LDX $10,Y
+                   "LDY #$F5\n .byte $B6, $20\n"      // LDX $20,Y, wrapping to $15
+                   "LDY #$10\n .byte $BE, $F8, $12\n" // LDX $12F8,Y, crossing into $13
+                   "LDX #$AB\n LDY #$F0\n .byte $96, $30\n" // STX $30,Y, wrapping to $20
+                   ".org $15\n .byte $77\n"
+                   ".org $1308\n .byte $99");
+    CHECK_EQ(m.step(2).X, 0x77);
+    CHECK_EQ(m.step(2).X, 0x77);
+    uint64_t cycles = m.cpu->get_cycles();
+    CHECK_EQ(m.step(2).X, 0x99);
+    CHECK_EQ(m.cpu->get_cycles() - cycles, 2 + 5);
+    m.step(3);
+    CHECK_EQ(m.mem->read_byte(0x20), 0xAB);
+    CHECK_EQ(m.mem->read_byte(0x120), 0x00);
+}
+
+template <class Bus>
+void test_php_plp() {
+    // PHP pushes B and bit 5 set, PLP drops B and keeps bit 5 set
+    Machine<Bus> m("SEC\n PHP\n LDA #$FF\n PHA\n PLP\n LDA #$00\n PHA\n PLP");
+    Registers r = m.step(2);
+    CHECK_EQ(m.mem->read_byte(0x1FF), CONSTANT | BREAK | CARRY);
+    CHECK_EQ(r.S, 0xFE);
+    CHECK_EQ(m.step(3).P, 0xFF & ~BREAK);
+    CHECK_EQ(m.step(3).P, CONSTANT);
+}
+
+template <class Bus>
+void test_brk_rti() {
+    // BRK skips its padding byte, RTI resumes exactly where the return address says
+    Machine<Bus> m("SEC\n BRK\n .byte $EA\n LDA #$42\n"
+                   ".org $0700\n RTI");
+    m.step();
+    Registers r = m.step();
+    CHECK_EQ(r.PC, 0x0700);
+    CHECK_EQ(r.S, 0xFC);
+    CHECK_EQ(r.P, CONSTANT | INTERRUPT | CARRY);
+    CHECK_EQ(m.mem->read_word(0x1FE), 0x0603);
+    CHECK_EQ(m.mem->read_byte(0x1FD), CONSTANT | BREAK | CARRY);
+    r = m.step();
+    CHECK_EQ(r.PC, 0x0603);
+    CHECK_EQ(r.S, 0xFF);
+    CHECK_EQ(r.P, CONSTANT | CARRY);
+    CHECK_EQ(m.step().A, 0x42);
+}
+
+template <class Bus>
+void test_nmi_irq() {
+    // Interrupts push the address of the next instruction, with B clear
+    Machine<Bus> m("SEC\n NOP\n SEI\n NOP\n"
+                   ".org $0700\n RTI\n"
+                   ".org $0800\n RTI");
+    m.step();
+    uint64_t cycles = m.cpu->get_cycles();
+    m.cpu->nmi();
+    Registers r = m.cpu->get_registers();
+    CHECK_EQ(r.PC, 0x0800);
+    CHECK_EQ(r.P, CONSTANT | INTERRUPT | CARRY);
+    CHECK_EQ(m.mem->read_word(0x1FE), 0x0601);
+    CHECK_EQ(m.mem->read_byte(0x1FD), CONSTANT | CARRY);
+    r = m.step();
+    CHECK_EQ(r.PC, 0x0601);
+    CHECK_EQ(r.P, CONSTANT | CARRY);
+    CHECK_EQ(m.cpu->get_cycles() - cycles, 7 + 6); // The sequence, then RTI
+
+    m.cpu->irq();
+    r = m.cpu->get_registers();
+    CHECK_EQ(r.PC, 0x0700);
+    CHECK_EQ(m.mem->read_word(0x1FE), 0x0601);
+    CHECK_EQ(m.mem->read_byte(0x1FD), CONSTANT | CARRY);
+    CHECK_EQ(m.step().PC, 0x0601);
+
+    // Masked once I is set
+    m.step(2);
+    m.cpu->irq();
+    CHECK_EQ(m.cpu->get_pc(), 0x0603);
+}
+
+template <class Bus>
+void test_jmp_indirect_wrap() {
+    // The pointer's high byte comes from $1000, not $1100
+    Machine<Bus> m("JMP ($10FF)\n"
+                   ".org $10FF\n .byte $34\n"
+                   ".org $1000\n .byte $12\n"
+                   ".org $1100\n .byte $56");
+    CHECK_EQ(m.step().PC, 0x1234);
+}
+
+template <class Bus>
+void test_indirect_index() {
+    // Indexes are unsigned, and pointers wrap within the zero page
+    Machine<Bus> m("LDY #$80\n LDA ($20),Y\n"
+                   "LDX #$80\n LDA ($10,X)\n"
+                   "LDY #$00\n LDA ($FF),Y\n"
+                   "LDX #$F0\n LDA ($0F,X)\n"
+                   ".org $00\n .byte $40\n"
+                   ".org $20\n .word $3000\n"
+                   ".org $90\n .word $3100\n"
+                   ".org $FF\n .byte $00\n"
+                   ".org $3080\n .byte $11\n"
+                   ".org $3100\n .byte $22\n"
+                   ".org $4000\n .byte $33");
+    CHECK_EQ(m.step(2).A, 0x11);
+    CHECK_EQ(m.step(2).A, 0x22);
+    CHECK_EQ(m.step(2).A, 0x33);
+    CHECK_EQ(m.step(2).A, 0x33);
+}
+
+template <class Bus>
+void test_zero_page_wrap() {
+    Machine<Bus> m("LDX #$20\n LDA $F0,X\n LDY #$F1\n LDX #$00\n STY $F0,X\n LDX #$F1\n INC $20,X\n"
+                   ".org $10\n .byte $5A\n"
+                   ".org $110\n .byte $A5");
+    CHECK_EQ(m.step(2).A, 0x5A);
+    m.step(5);
+    CHECK_EQ(m.mem->read_byte(0x11), 0x01);
+    CHECK_EQ(m.mem->read_byte(0xF0), 0xF1);
+    CHECK_EQ(m.mem->read_byte(0x111), 0x00);
+}
+
+template <class Bus>
+void test_absolute_operands() {
+    // Absolute operands name the address accessed, and leave the instruction's own bytes alone
+    Machine<Bus> m("LDA $1234\n STA $2345\n INC $2345\n ASL $2345\n"
+                   ".org $1234\n .byte $21");
+    CHECK_EQ(m.step().A, 0x21);
+    m.step(3);
+    CHECK_EQ(m.mem->read_byte(0x2345), 0x44);
+    CHECK_EQ(m.mem->read_word(0x0601), 0x1234);
+    CHECK_EQ(m.mem->read_word(0x0604), 0x2345);
+    CHECK_EQ(m.mem->read_word(0x0607), 0x2345);
+    CHECK_EQ(m.mem->read_word(0x060A), 0x2345);
+}
+
+template <class Bus>
+void test_bus() {
+    test_compare<Bus>();
+    test_bit<Bus>();
+    test_binary_overflow<Bus>();
+    test_pla_txs_flags<Bus>();
+    test_y_indexed_ldx_stx<Bus>();
+    test_php_plp<Bus>();
+    test_brk_rti<Bus>();
+    test_nmi_irq<Bus>();
+    test_jmp_indirect_wrap<Bus>();
+    test_indirect_index<Bus>();
+    test_zero_page_wrap<Bus>();
+    test_absolute_operands<Bus>();
+}
+
+void test_ram_word_wrap() {
+    RAM<0x10000> mem;
+    mem.clear();
+    mem.write_word(0xFFFF, 0x1234);
+    CHECK_EQ(mem.read_byte(0xFFFF), 0x34);
+    CHECK_EQ(mem.read_byte(0x0000), 0x12);
+    CHECK_EQ(mem.read_word(0xFFFF), 0x1234);
+}
+
+
+// Vectors are fetched like instructions, so read watchpoints on them only see the program's own reads
+void test_vector_fetches() {
+    Machine<PagedMemory> m("BRK\n .byte $EA\n LDA $FFFE\n"
+                           ".org $0700\n RTI\n"
+                           ".org $0800\n RTI");
+    auto debugger = std::make_shared<Debugger>();
+    debugger->add_watchpoint(0xFFFA, 6, WatchKind::READ);
+    m.cpu->set_debugger(debugger);
+    m.cpu->reset();
+
+    CHECK_EQ((int) m.cpu->run_instructions(1).reason, (int) StopReason::BUDGET);
+    CHECK_EQ(m.cpu->get_pc(), 0x0700);
+    m.cpu->run_instructions(1);
+    m.cpu->nmi();
+    CHECK_EQ((int) m.cpu->run_instructions(1).reason, (int) StopReason::BUDGET);
+    m.cpu->irq();
+    CHECK_EQ((int) m.cpu->run_instructions(1).reason, (int) StopReason::BUDGET);
+    CHECK_EQ(m.cpu->get_pc(), 0x0602);
+
+    CHECK_EQ((int) m.cpu->run_instructions(2).reason, (int) StopReason::WATCHPOINT);
+    CHECK_EQ(debugger->event().address, 0xFFFE);
+}
+
+// Runs Y from 1 to 4 through an outer loop, each pass storing Y to $F000 after 256 passes of an inner loop
+const char *const nested_loops =
+    "        LDY #$00\n"
+    "outer:  LDX #$00\n"
+    "inner:  INX\n"        // $0604
+    "        BNE inner\n"
+    "        INY\n"        // $0607
+    "        STY $F000\n"
+    "        CPY #$04\n"   // $060B
+    "        BNE outer\n"
+    "        BRK";
+
+// set_stop_pc and request_stop end batched runs exactly where they say, block cache or not
+void test_stops(bool block_cache) {
+    Machine<PagedMemory> m(nested_loops);
+    m.mem->map_io(0xF000, nullptr, [&m](uint16_t, uint8_t data) { if (data == 2) m.cpu->request_stop(); });
+    m.cpu->set_block_cache(block_cache);
+    m.cpu->set_stop_on_brk(true);
+
+    m.cpu->set_stop_pc(0x0607);
+    CHECK_EQ((int) m.cpu->run_cycles(100000).reason, (int) StopReason::BREAKPOINT);
+    Registers r = m.cpu->get_registers();
+    CHECK_EQ(r.PC, 0x0607);
+    CHECK_EQ(r.Y, 0x00);
+    CHECK_EQ(m.cpu->get_cycles(), 2 + 2 + 255 * 5 + 4);
+
+    // The stop PC is cleared once reached, so the next stop is the one the handler asks for
+    CHECK_EQ((int) m.cpu->run_cycles(100000).reason, (int) StopReason::BREAKPOINT);
+    r = m.cpu->get_registers();
+    CHECK_EQ(r.PC, 0x060B);
+    CHECK_EQ(r.Y, 0x02);
+    CHECK_EQ(m.cpu->get_cycles(), 2 + 1292 + 1287);
+
+    CHECK_EQ((int) m.cpu->run_cycles(100000).reason, (int) StopReason::BRK);
+    CHECK_EQ(m.cpu->get_registers().Y, 0x04);
+}
+
+// An IRQ line raised while I is set is held until CLI, then taken once, until the handler acknowledges it
+void test_irq_line(bool block_cache) {
+    Machine<PagedMemory> m("        SEI\n"
+                           "        LDX #$00\n"
+                           "loop:   INX\n"
+                           "        BNE loop\n"
+                           "        CLI\n"
+                           "        NOP\n"    // $0607
+                           "        BRK\n"
+                           ".org $0700\n"
+                           "        STA $F000\n"
+                           "        RTI");
+    int acks = 0;
+    uint16_t return_address = 0;
+    m.mem->map_io(0xF000, nullptr, [&](uint16_t, uint8_t) {
+        acks++;
+        return_address = m.mem->read_word(0x1FE);
+        m.cpu->set_irq_line(false);
+    });
+
+    auto events = std::make_shared<EventScheduler>();
+    bool cancelled_ran = false;
+    EventScheduler::id_t cancelled = events->schedule(50, [&](uint64_t) { cancelled_ran = true; });
+    events->schedule(100, [&](uint64_t) { m.cpu->set_irq_line(true); });
+    CHECK(events->cancel(cancelled));
+    CHECK(!events->cancel(cancelled));
+    CHECK_EQ(events->pending(), 1);
+
+    m.cpu->set_events(events);
+    m.cpu->set_block_cache(block_cache);
+    m.cpu->set_stop_on_brk(true);
+    CHECK_EQ((int) m.cpu->run_cycles(100000).reason, (int) StopReason::BRK);
+    CHECK_EQ(acks, 1);
+    CHECK_EQ(return_address, 0x0607);
+    CHECK_EQ(m.cpu->get_pc(), 0x0608);
+    CHECK(!cancelled_ran);
+    CHECK_EQ(events->pending(), 0);
+}
+
+}
+
+int main() {
+    test_bus<Memory>();
+    test_bus<RAM<0x10000>>();
+    test_bus<PagedMemory>();
+    test_ram_word_wrap();
+    test_vector_fetches();
+    test_stops(false);
+    test_stops(true);
+    test_irq_line(false);
+    test_irq_line(true);
+    return test_result();
+}
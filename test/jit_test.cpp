@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cpu_6502.h"
+#include "loader.h"
+#include "paged_memory.h"
+#include "test.h"
+
+// Runs the same programs on the interpreter and on the recompiler, in the same slices of cycles,
+// and checks that they end with the same registers, cycle counts and memory
+
+namespace {
+
+const uint16_t code_start = 0x0600;
+const uint16_t loop_counter = 0x0300;
+
+struct Engine {
+    std::shared_ptr<PagedMemory> mem = std::make_shared<PagedMemory>();
+    CPU6502<PagedMemory> cpu{mem};
+};
+
+// Returns why the interpreter's last slice stopped
+StopReason compare(const std::string &name, std::function<void(PagedMemory &mem)> load,
+                   const std::vector<uint64_t> &slices, bool stop_on_brk=false) {
+    int failures = test_failures();
+    Engine interpreter, jit;
+    for (Engine *engine : { &interpreter, &jit }) {
+        load(*engine->mem);
+        engine->cpu.reset();
+        engine->cpu.set_stop_on_brk(stop_on_brk);
+    }
+    jit.cpu.set_jit(true);
+
+    StopReason reason = StopReason::BUDGET;
+    for (uint64_t slice : slices) {
+        RunResult expected = interpreter.cpu.run_cycles(slice);
+        RunResult actual = jit.cpu.run_cycles(slice);
+        CHECK_EQ(actual.cycles, expected.cycles);
+        CHECK_EQ((int) actual.reason, (int) expected.reason);
+        reason = expected.reason;
+        if (reason != StopReason::BUDGET || test_failures() > failures) break;
+    }
+
+    Registers expected = interpreter.cpu.get_registers(), actual = jit.cpu.get_registers();
+    CHECK_EQ(actual.A, expected.A);
+    CHECK_EQ(actual.X, expected.X);
+    CHECK_EQ(actual.Y, expected.Y);
+    CHECK_EQ(actual.P, expected.P);
+    CHECK_EQ(actual.S, expected.S);
+    CHECK_EQ(actual.PC, expected.PC);
+    CHECK_EQ(jit.cpu.get_cycles(), interpreter.cpu.get_cycles());
+    CHECK_EQ(jit.cpu.save_state().cycles_left, interpreter.cpu.save_state().cycles_left);
+    CHECK_EQ(jit.cpu.is_halted(), interpreter.cpu.is_halted());
+    for (uint32_t addr = 0; addr < 0x10000 && test_failures() == failures; addr++) {
+        CHECK_EQ(jit.mem->read_byte(addr), interpreter.mem->read_byte(addr));
+    }
+    if (test_failures() > failures) std::cerr << "  in " << name << '\n';
+    return reason;
+}
+
+// A loop of random instructions, run enough times to be translated, that does not jump or call anywhere
+// Branches skip nothing, taken or not, and most absolute operands stay in page 2,
+// but indirect pointers come from random zero page bytes, so stores may land anywhere, code included
+void load_random(PagedMemory &mem, uint32_t seed) {
+    std::mt19937 rng(seed);
+    uint8_t page[0x100];
+    for (uint16_t base : { 0x0000, 0x0200 }) {
+        for (int i = 0; i < 0x100; i++) page[i] = rng();
+        mem.load(base, page, sizeof(page));
+    }
+
+    std::vector<uint8_t> code;
+    for (int count = 0; count < 24; ) {
+        uint8_t opcode = rng();
+        const InstrInfo &info = Instructions::info[opcode];
+        bool control = opcode == 0x00 || opcode == 0x20 || opcode == 0x40 || opcode == 0x4C
+            || opcode == 0x60 || opcode == 0x6C;
+        if (!Instructions::is_legal(opcode) || control) continue;
+
+        uint16_t operand = rng();
+        if (info.mode == Mode::REL) operand = 0x00;
+        else if (Instructions::length_table[opcode] == 2 && rng() % 4 != 0) operand = 0x0200 | (operand & 0xFF);
+        code.push_back(opcode);
+        if (Instructions::length_table[opcode] >= 1) code.push_back(operand & 0xFF);
+        if (Instructions::length_table[opcode] == 2) code.push_back(operand >> 8);
+        count++;
+    }
+    // DEC loop_counter / BNE code_start / done: JMP done
+    uint16_t done = code_start + code.size() + 5;
+    code.insert(code.end(), { 0xCE, loop_counter & 0xFF, loop_counter >> 8, 0xD0,
+                              (uint8_t) (code_start - (code_start + code.size() + 5)),
+                              0x4C, (uint8_t) (done & 0xFF), (uint8_t) (done >> 8) });
+    mem.load(code_start, code.data(), code.size());
+
+    mem.write_byte(loop_counter, 40);
+    mem.write_word(RST_VEC, code_start);
+    mem.write_word(IRQ_VEC, code_start);
+}
+
+void test_random_programs() {
+    std::vector<uint64_t> slices;
+    for (int i = 0; i < 100; i++) slices.push_back(50 + (i * 37) % 100);
+
+    for (uint32_t seed = 0; seed < 500; seed++) {
+        compare("random program " + std::to_string(seed),
+                [seed](PagedMemory &mem) { load_random(mem, seed); }, slices);
+    }
+}
+
+// The benchmark programs, run from reset until BRK
+void test_bench_programs() {
+    for (const char *name : { "crc32", "sieve", "sort" }) {
+        ProgramImage image = Loader::load(std::string(CPU6502_BENCH_DIR) + "/" + name + ".hex");
+        StopReason reason = compare(name, [&image](PagedMemory &mem) { image.load_into(mem); },
+                                    std::vector<uint64_t>(1000, 10007), true);
+        CHECK_EQ((int) reason, (int) StopReason::BRK);
+    }
+}
+
+
+// A stop PC set inside a loop that is already translated, and running natively, still stops the CPU on it
+void test_stop_pc() {
+    // LDY #$00 / outer: LDX #$00 / inner: INX / BNE inner / INY / BNE outer
+    const uint8_t code[] = { 0xA0, 0x00, 0xA2, 0x00, 0xE8, 0xD0, 0xFD, 0xC8, 0xD0, 0xF8 };
+    Engine interpreter, jit;
+    jit.cpu.set_jit(true);
+    for (Engine *engine : { &interpreter, &jit }) {
+        engine->mem->load(code_start, code, sizeof(code));
+        engine->mem->write_word(RST_VEC, code_start);
+        engine->cpu.reset();
+        engine->cpu.run_cycles(3000);
+        engine->cpu.set_stop_pc(code_start + 5);
+    }
+
+    RunResult expected = interpreter.cpu.run_cycles(100000);
+    RunResult actual = jit.cpu.run_cycles(100000);
+    CHECK_EQ((int) expected.reason, (int) StopReason::BREAKPOINT);
+    CHECK_EQ((int) actual.reason, (int) StopReason::BREAKPOINT);
+    CHECK_EQ(actual.cycles, expected.cycles);
+    CHECK_EQ(jit.cpu.get_pc(), code_start + 5);
+    CHECK_EQ(jit.cpu.get_registers().X, interpreter.cpu.get_registers().X);
+    CHECK_EQ(jit.cpu.get_registers().Y, interpreter.cpu.get_registers().Y);
+}
+
+// Host seconds to run a program from reset to BRK with the recompiler on,
+// the best of several runs, so that noise on the machine can only make it look faster
+// Engines are reused and their code dropped between runs, as the benchmark does,
+// and the two modes take turns, so that both see the same machine
+void test_block_cache_with_jit() {
+    for (const char *name : { "crc32", "sieve", "sort" }) {
+        ProgramImage image = Loader::load(std::string(CPU6502_BENCH_DIR) + "/" + name + ".hex");
+        Engine engines[2];
+        std::vector<PagedMemory::Snapshot> starts;
+        double best[2] = { std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+        for (int i = 0; i < 2; i++) {
+            image.load_into(*engines[i].mem);
+            starts.push_back(engines[i].mem->snapshot());
+            engines[i].cpu.set_stop_on_brk(true);
+            engines[i].cpu.set_jit(true);
+            engines[i].cpu.set_block_cache(i == 1);
+        }
+
+        for (int run = 0; run < 20; run++) {
+            for (int i = 0; i < 2; i++) {
+                engines[i].mem->restore(starts[i]);
+                engines[i].cpu.invalidate_code();
+                engines[i].cpu.reset();
+
+                auto start = std::chrono::steady_clock::now();
+                RunResult result = engines[i].cpu.run_cycles(std::numeric_limits<uint64_t>::max());
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                CHECK_EQ((int) result.reason, (int) StopReason::BRK);
+                best[i] = std::min(best[i], elapsed.count());
+            }
+        }
+
+        // The block cache must not keep translated code from running, which once halved the throughput
+        // The margin is for timing noise, well below the slowdown it guards against
+        CHECK(best[1] < best[0] * 1.3);
+        if (best[1] >= best[0] * 1.3) {
+            std::cerr << "  in " << name << ": " << best[1] << "s with the block cache, " << best[0] << "s without\n";
+        }
+    }
+}
+
+}
+
+int main() {
+    test_random_programs();
+    test_bench_programs();
+    test_stop_pc();
+    test_block_cache_with_jit();
+    return test_result();
+}
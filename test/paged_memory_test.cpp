@@ -0,0 +1,136 @@
+#include <memory>
+#include <vector>
+
+#include "assembler.h"
+#include "cpu_6502.h"
+#include "paged_memory.h"
+#include "test.h"
+
+// Memory-mapped I/O is byte-granular: only the mapped addresses reach their handlers,
+// and the rest of their page stays in the page table
+
+namespace {
+
+void test_mapped_addresses() {
+    PagedMemory mem;
+    std::vector<uint16_t> reads, writes;
+    mem.map_io(0x00FE, [&](uint16_t addr) { reads.push_back(addr); return 0x5A; },
+               [&](uint16_t addr, uint8_t) { writes.push_back(addr); });
+
+    const PageTable *table = mem.page_table();
+    CHECK(table->io[0x00] != nullptr);
+    CHECK(table->io[0x01] == nullptr);
+    CHECK(table->read_page(0x00FE) == nullptr);
+    CHECK(table->read_page(0x00FD) != nullptr);
+    CHECK(table->read_page(0x00FF) != nullptr);
+
+    mem.write_byte(0x00FD, 0x11);
+    mem.write_byte(0x00FF, 0x22);
+    mem.write_byte(0x00FE, 0x33);
+    CHECK_EQ(mem.read_byte(0x00FD), 0x11);
+    CHECK_EQ(mem.read_byte(0x00FF), 0x22);
+    CHECK_EQ(mem.read_byte(0x00FE), 0x5A);
+    CHECK_EQ(mem.read_word(0x00FD), 0x5A11);
+    CHECK(reads == std::vector<uint16_t>({ 0x00FE, 0x00FE }));
+    CHECK(writes == std::vector<uint16_t>({ 0x00FE }));
+
+    // The rest of the page is written straight through the page table once it has a private copy
+    CHECK(table->write_page(0x00FD) != nullptr);
+    CHECK(table->write_page(0x00FE) == nullptr);
+    CHECK_EQ(table->read_page(0x00FD)[0xFD], 0x11);
+}
+
+void test_one_direction() {
+    // Without a write handler, writes land in plain memory, which reads do not see past the handler
+    PagedMemory mem;
+    int reads = 0;
+    mem.map_io(0x4000, [&](uint16_t) { return ++reads; });
+    mem.write_byte(0x4000, 0x77);
+    CHECK_EQ(mem.read_byte(0x4000), 1);
+    CHECK_EQ(mem.page_table()->io[0x40]->read[0x00], 0x77);
+
+    // Without a read handler, reads see the last byte written to plain memory
+    uint8_t written = 0;
+    mem.map_io(0x4001, nullptr, [&](uint16_t, uint8_t data) { written = data; });
+    const uint8_t data[] = { 0x99 };
+    mem.load(0x4001, data, 1);
+    mem.write_byte(0x4001, 0x12);
+    CHECK_EQ(written, 0x12);
+    CHECK_EQ(mem.read_byte(0x4001), 0x99);
+    CHECK_EQ(reads, 1);
+}
+
+void test_remapping() {
+    PagedMemory mem;
+    mem.map_io(0x0010, [](uint16_t) { return 0x42; });
+    PagedMemory::Snapshot mapped = mem.snapshot();
+
+    mem.map_ram(0x00);
+    CHECK(mem.page_table()->io[0x00] == nullptr);
+    CHECK_EQ(mem.read_byte(0x0010), 0x00);
+
+    mem.restore(mapped);
+    CHECK(mem.page_table()->read_page(0x0010) == nullptr);
+    CHECK_EQ(mem.read_byte(0x0010), 0x42);
+
+    PagedMemory fork(mapped);
+    CHECK_EQ(fork.read_byte(0x0010), 0x42);
+    CHECK(fork.page_table()->read_page(0x0011) != nullptr);
+}
+
+// A loop reading a port at $FE and writing it to one at $FF, after plain zero page accesses
+// that translated code makes itself, and following a pointer whose high byte is the port at $FE
+const char *io_loop = R"(
+        LDX #0
+        LDY #200
+loop:   INC $20
+        STX $FD
+        LDA $FE
+        STA $FF
+        LDA ($FD),Y
+        STA $0200,Y
+        DEY
+        BNE loop
+done:   JMP done
+)";
+
+template <class Bus>
+void test_cpu(bool block_cache, bool jit) {
+    auto mem = std::make_shared<PagedMemory>();
+    Assembler assembler;
+    mem->write_word(RST_VEC, assembler.assemble(io_loop, *mem));
+    for (int i = 0; i < 0x100; i++) mem->write_byte(0x3000 + i, i);
+
+    int reads = 0;
+    uint32_t sum = 0;
+    mem->map_io(0x00FE, [&](uint16_t) { reads++; return 0x30; });
+    mem->map_io(0x00FF, nullptr, [&](uint16_t, uint8_t data) { sum += data; });
+
+    CPU6502<Bus> cpu(mem);
+    cpu.set_block_cache(block_cache);
+    cpu.set_jit(jit);
+    cpu.run_cycles(100000);
+
+    CHECK_EQ(cpu.get_pc(), *assembler.symbol("done"));
+    CHECK_EQ(reads, 2 * 200);
+    CHECK_EQ(sum, 0x30 * 200);
+    CHECK_EQ(mem->read_byte(0x20), 200);
+    CHECK_EQ(mem->read_byte(0xFD), 0x00);
+    CHECK_EQ(mem->read_byte(0xFF), 0x00);
+    for (int y = 1; y <= 200; y++) CHECK_EQ(mem->read_byte(0x0200 + y), y);
+}
+
+}
+
+int main() {
+    test_mapped_addresses();
+    test_one_direction();
+    test_remapping();
+    for (bool block_cache : { false, true }) {
+        for (bool jit : { false, true }) {
+            test_cpu<PagedMemory>(block_cache, jit);
+            test_cpu<Memory>(block_cache, jit);
+        }
+    }
+    return test_result();
+}
@@ -0,0 +1,39 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+
+// Minimal checks for the test programs, which carry on past a failed check
+// and exit with a non-zero status if any failed
+
+inline int &test_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition) do { \
+        if (!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed\n"; \
+            test_failures()++; \
+        } \
+    } while (0)
+
+// For integers, compared as uint64_t and printed in hex, which suits registers, flags and memory
+#define CHECK_EQ(actual, expected) do { \
+        auto actual_value = (actual); \
+        auto expected_value = (expected); \
+        if ((uint64_t) actual_value != (uint64_t) expected_value) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " #actual " is $" << std::hex << std::uppercase \
+                      << (uint64_t) actual_value << ", expected $" << (uint64_t) expected_value << std::dec << '\n'; \
+            test_failures()++; \
+        } \
+    } while (0)
+
+inline int test_result() {
+    if (test_failures()) std::cerr << test_failures() << " checks failed\n";
+    return test_failures() ? 1 : 0;
+}
+
+#endif // TEST_H